@@ -3,12 +3,17 @@
 #include <boost/algorithm/string.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/asio/signal_set.hpp>
+#include <boost/asio/steady_timer.hpp>
 #include <boost/algorithm/string.hpp>
 
 #include <iostream>
 #include <fstream>
 #include <unordered_map>
 #include <future>
+#include <set>
+#include <sstream>
+#include <iomanip>
+#include <condition_variable>
 
 namespace appbase {
 
@@ -26,6 +31,8 @@ class application_impl {
       options_description     _app_options;
       options_description     _cfg_options;
       variables_map           _options;
+      std::set<string>        _cli_options;   ///< options given on the command line, which a config reload keeps
+      std::unordered_map<string, abstract_plugin*> _option_owners; ///< config option to the plugin that declared it
 
       bfs::path               _data_dir{"data-dir"};
       bfs::path               _config_dir{"config-dir"};
@@ -38,12 +45,53 @@ class application_impl {
 
       std::atomic_bool        _is_quiting{false};
 
+      uint32_t                _exec_batch_size = 1;
+      std::chrono::microseconds _exec_batch_time{0};
+
+      uint32_t                _plugin_init_threads = 1;
+      uint32_t                _shutdown_threads = 1;
+      std::chrono::milliseconds _shutdown_drain_time{0};       ///< 0 for no limit
+      int                     _shutdown_drain_priority = priority::lowest;
+      std::chrono::milliseconds _shutdown_plugin_budget{0};    ///< 0 for no budget
+
+      enum class idle_strategy { block, spin, busy_poll };
+      idle_strategy           _idle_strategy = idle_strategy::block;
+      std::chrono::microseconds _idle_spin_time{50};
+      bool                    _print_wakeup_statistics = false;
+      mutable std::mutex      _wakeup_mtx;
+      wakeup_statistics       _wakeups;
+      plugin_critical_path    _initialize_critical_path;
+      plugin_critical_path    _startup_critical_path;
+      plugin_critical_path    _shutdown_critical_path;
+
+      lifecycle_profile       _profile;
+      std::map<abstract_plugin*, size_t> _profile_index; ///< plugin to index of _profile.plugins
+      bool                    _print_startup_profile = false;
+
+      thread_placement        _exec_placement;    ///< applied by startup() to the calling thread
+      thread_placement        _worker_placement;  ///< applied by the additional exec() threads
+      thread_placement        _signal_placement;  ///< applied by the signal handling threads
+
+      std::unique_ptr<boost::asio::io_service> _trace_signal_ios; ///< SIGUSR1 is handled off the exec() thread, which may be stalled
+      std::thread             _trace_signal_thread;
+      uint32_t                _trace_dumps = 0;
+
+      timer_wheel             _timers;
+      std::mutex              _timers_mtx;
+      std::chrono::steady_clock::time_point _timer_armed_at = std::chrono::steady_clock::time_point::max(); ///< expiry of _wheel_timer, guarded by _timers_mtx
+      std::unique_ptr<boost::asio::steady_timer> _wheel_timer; ///< created and only used on the io_service thread
+      std::vector<std::pair<int, impl::handler_function>> _expired_timers;
+
       any_type_compare_map    _any_compare_map;
 };
 
 application::application()
 :my(new application_impl()){
    io_serv = std::make_shared<boost::asio::io_service>();
+   // rethrown on the application queue, so that exec() throws it like the exception of any other handler
+   bg_pool.set_exception_handler([this](std::exception_ptr e) {
+      post( priority::highest, [e]() { std::rethrow_exception(e); } );
+   });
 
    register_config_type<std::string>();
    register_config_type<bool>();
@@ -60,7 +108,9 @@ application::application()
    register_config_type<boost::filesystem::path>();
 }
 
-application::~application() { }
+application::~application() {
+   stop_trace_signal_thread();
+}
 
 void application::set_version(uint64_t version) {
   my->_version = version;
@@ -121,10 +171,15 @@ void application::setup_signal_handling_on_ios(boost::asio::io_service& ios, boo
 }
 
 void application::startup() {
+   const std::string placement_error = my->_exec_placement.apply_to_current_thread();
+   if( !placement_error.empty() )
+      BOOST_THROW_EXCEPTION(std::runtime_error("Unable to apply exec-thread-cpus / exec-sched-policy: " + placement_error));
+
    //during startup, run a second thread to catch SIGINT/SIGTERM/SIGPIPE/SIGHUP
    boost::asio::io_service startup_thread_ios;
    setup_signal_handling_on_ios(startup_thread_ios, true);
-   std::thread startup_thread([&startup_thread_ios]() {
+   std::thread startup_thread([&startup_thread_ios, this]() {
+      place_signal_thread();
       startup_thread_ios.run();
    });
    auto clean_up_signal_thread = [&startup_thread_ios, &startup_thread]() {
@@ -133,17 +188,26 @@ void application::startup() {
    };
 
    try {
-      for( auto plugin : initialized_plugins ) {
-         if( is_quiting() ) break;
-         plugin->startup();
+      vector<abstract_plugin*> to_start;
+      {
+         std::lock_guard<std::mutex> g(plugin_state_mtx);
+         to_start = initialized_plugins;
       }
-
+      const auto startup_start = std::chrono::steady_clock::now();
+      my->_startup_critical_path = run_plugins( to_start, my->_plugin_init_threads,
+                                                [](abstract_plugin& plugin) { plugin.startup(); },
+                                                [this]() { return is_quiting(); },
+                                                &plugin_profile::startup );
+      my->_profile.startup = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startup_start);
    } catch( ... ) {
       clean_up_signal_thread();
       shutdown();
       throw;
    }
 
+   if( my->_print_startup_profile )
+      print_lifecycle_profile(std::cerr);
+
    //after startup, shut down the signal handling thread and catch the signals back on main io_service
    clean_up_signal_thread();
    setup_signal_handling_on_ios(get_io_service(), false);
@@ -152,14 +216,68 @@ void application::startup() {
    std::shared_ptr<boost::asio::signal_set> sighup_set(new boost::asio::signal_set(get_io_service(), SIGHUP));
    start_sighup_handler( sighup_set );
 #endif
+#ifdef SIGUSR1
+   if( trace_recorder::enabled() && !my->_trace_signal_thread.joinable() ) {
+      my->_trace_signal_ios = std::make_unique<boost::asio::io_service>();
+      std::shared_ptr<boost::asio::signal_set> sigusr1_set(new boost::asio::signal_set(*my->_trace_signal_ios, SIGUSR1));
+      start_sigusr1_handler( sigusr1_set );
+      my->_trace_signal_thread = std::thread([ios = my->_trace_signal_ios.get(), this]() {
+         place_signal_thread();
+         ios->run();
+      });
+   }
+#endif
+}
+
+void application::place_signal_thread() {
+   const std::string error = my->_signal_placement.apply_to_current_thread();
+   if( !error.empty() )
+      std::cerr << "APPBASE: Unable to apply signal-thread-cpus: " << error << std::endl;
+}
+
+void application::start_sigusr1_handler( std::shared_ptr<boost::asio::signal_set> sigusr1_set ) {
+#ifdef SIGUSR1
+   sigusr1_set->async_wait([sigusr1_set, this](const boost::system::error_code& err, int /*num*/) {
+      if( err ) return;
+      write_trace_file();
+      start_sigusr1_handler( sigusr1_set );
+   });
+#endif
+}
+
+void application::write_trace_file() {
+#ifndef _WIN32
+   const long pid = ::getpid();
+#else
+   const long pid = 0;
+#endif
+   bfs::path file = data_dir() / ("trace-" + std::to_string(pid) + "-" + std::to_string(++my->_trace_dumps) + ".json");
+   std::ofstream out(file.string());
+   trace_recorder::instance().write_chrome_trace(out);
+   if( out )
+      std::cerr << "APPBASE: wrote handler trace to " << file.string() << std::endl;
+   else
+      std::cerr << "APPBASE: failed to write handler trace to " << file.string() << std::endl;
+}
+
+void application::stop_trace_signal_thread() {
+   if( my->_trace_signal_thread.joinable() ) {
+      my->_trace_signal_ios->stop();
+      my->_trace_signal_thread.join();
+      my->_trace_signal_ios.reset();
+   }
 }
 
 void application::start_sighup_handler( std::shared_ptr<boost::asio::signal_set> sighup_set ) {
 #ifdef SIGHUP
    sighup_set->async_wait([sighup_set, this](const boost::system::error_code& err, int /*num*/) {
       if( err ) return;
-      app().post(priority::medium, [sighup_set, this]() {
-         sighup_callback();
+      // on the thread running the io_service, reload_config() must not run on a worker of exec(num_threads)
+      boost::asio::post(*io_serv, [sighup_set, this]() {
+         if( is_quiting() ) return;
+         reload_config();
+         if( sighup_callback )
+            sighup_callback();
          for( auto plugin : initialized_plugins ) {
             if( is_quiting() ) return;
             plugin->handle_sighup();
@@ -176,6 +294,11 @@ application& application::instance() {
 }
 application& app() { return application::instance(); }
 
+size_t application::next_decl_slot() {
+   static std::atomic<size_t> next{0};
+   return next++;
+}
+
 void application::register_config_type_comparison(std::type_index i, config_comparison_f comp) {
    my->_any_compare_map.emplace(i, comp);
 }
@@ -186,6 +309,8 @@ void application::set_program_options()
       boost::program_options::options_description plugin_cli_opts("Command Line Options for " + plug.second->name());
       boost::program_options::options_description plugin_cfg_opts("Config Options for " + plug.second->name());
       plug.second->set_program_options(plugin_cli_opts, plugin_cfg_opts);
+      for(const auto& od_ptr : plugin_cfg_opts.options())
+         my->_option_owners.emplace(od_ptr->long_name(), plug.second.get());
       if(plugin_cfg_opts.options().size()) {
          my->_app_options.add(plugin_cfg_opts);
          my->_cfg_options.add(plugin_cfg_opts);
@@ -197,13 +322,38 @@ void application::set_program_options()
    options_description app_cfg_opts( "Application Config Options" );
    options_description app_cli_opts( "Application Command Line Options" );
    app_cfg_opts.add_options()
-         ("plugin", bpo::value< vector<string> >()->composing(), "Plugin(s) to enable, may be specified multiple times");
+         ("plugin", bpo::value< vector<string> >()->composing(), "Plugin(s) to enable, may be specified multiple times")
+         ("exec-batch-size", bpo::value<uint32_t>()->default_value( 1 ), "Maximum number of queued handlers exec() runs between polls of the io_service")
+         ("exec-batch-time-us", bpo::value<uint32_t>()->default_value( 0 ), "Maximum time in microseconds exec() runs queued handlers between polls of the io_service, 0 for no limit")
+         ("trace-handlers", bpo::bool_switch()->default_value(false), "Record the enqueue, start and finish of posted handlers, SIGUSR1 writes them to data-dir as a Chrome trace")
+         ("trace-buffer-events", bpo::value<uint32_t>()->default_value( 16384 ), "Number of handler trace events kept per thread")
+         ("handler-watchdog-ms", bpo::value<uint32_t>()->default_value( 0 ), "Report posted handlers running longer than this many milliseconds, 0 to disable")
+         ("handler-watchdog-stack", bpo::bool_switch()->default_value(false), "Include a stack sample of the thread running the handler in watchdog reports (Linux only)")
+         ("exec-scheduling", bpo::value<std::string>()->default_value( "binary_heap" ), "How queued handlers are ordered: binary_heap, bucketed, or bucketed_fair which bounds starvation of low priorities")
+         ("exec-starvation-limit", bpo::value<uint32_t>()->default_value( 16 ), "With exec-scheduling bucketed_fair, how many other handlers may run while a priority has handlers waiting before one of them runs")
+         ("plugin-init-threads", bpo::value<uint32_t>()->default_value( 1 ), "Number of threads running plugin initialize and startup; plugins that do not require each other run concurrently")
+         ("warn-redundant-config", bpo::value<bool>()->default_value( true ), "Warn about items in the config file that are set to their default value")
+         ("background-threads", bpo::value<uint32_t>()->default_value( 0 ), "Number of threads running app().post_background() handlers, 0 for one per core but one")
+         ("background-pin-threads", bpo::bool_switch()->default_value(false), "Pin each background thread to its own CPU (Linux only)")
+         ("exec-thread-cpus", bpo::value<std::string>()->default_value( "" ), "CPUs the thread running startup() and exec() is pinned to, a list of CPUs, CPU ranges and NUMA nodes such as 0,2-3,node:1 (Linux only)")
+         ("exec-worker-cpus", bpo::value<std::string>()->default_value( "" ), "CPUs the additional exec() threads are pinned to, see exec-thread-cpus")
+         ("signal-thread-cpus", bpo::value<std::string>()->default_value( "" ), "CPUs the signal handling threads are pinned to, see exec-thread-cpus")
+         ("exec-sched-policy", bpo::value<std::string>()->default_value( "" ), "Scheduling policy of the exec() threads: other, fifo or rr; leave empty to keep the inherited policy (Linux only)")
+         ("exec-sched-priority", bpo::value<int>()->default_value( 0 ), "Priority of the exec() threads with exec-sched-policy fifo or rr, 0 for the maximum")
+         ("exec-idle-strategy", bpo::value<std::string>()->default_value( "block" ), "How the thread running exec() waits for work: block in the io_service, spin for exec-idle-spin-us and then block, or busy-poll without ever blocking, best combined with exec-thread-cpus")
+         ("exec-idle-spin-us", bpo::value<uint32_t>()->default_value( 50 ), "Microseconds exec() spins before blocking with exec-idle-strategy spin")
+         ("shutdown-threads", bpo::value<uint32_t>()->default_value( 1 ), "Number of threads running plugin shutdown; a plugin still shuts down only after every plugin that requires it")
+         ("shutdown-drain-ms", bpo::value<uint32_t>()->default_value( 0 ), "Maximum time in milliseconds exec() keeps running queued handlers after quit() before shutting down the plugins, 0 for no limit")
+         ("shutdown-drain-priority", bpo::value<int>()->default_value( int(priority::lowest) ), "Lowest priority of the queued handlers exec() still runs after quit(), lower priority handlers are dropped")
+         ("shutdown-plugin-budget-ms", bpo::value<uint32_t>()->default_value( 0 ), "Report every plugin whose shutdown takes longer than this many milliseconds, 0 to not report");
 
    app_cli_opts.add_options()
          ("help,h", "Print this help message and exit.")
          ("version,v", "Print version information.")
          ("full-version", "Print full version information.")
          ("print-default-config", "Print default configuration template")
+         ("print-startup-profile", "Print the time spent initializing, starting and shutting down each plugin")
+         ("print-wakeup-statistics", "Print how long exec() took to notice posted handlers when it returns")
          ("data-dir,d", bpo::value<std::string>(), "Directory containing program runtime data")
          ("config-dir", bpo::value<std::string>(), "Directory containing configuration files such as config.ini")
          ("config,c", bpo::value<std::string>()->default_value( "config.ini" ), "Configuration file name relative to config-dir")
@@ -215,6 +365,7 @@ void application::set_program_options()
 }
 
 bool application::initialize_impl(int argc, char** argv, vector<abstract_plugin*> autostart_plugins) {
+   const auto options_start = std::chrono::steady_clock::now();
    set_program_options();
 
    bpo::variables_map& options = my->_options;
@@ -224,6 +375,10 @@ bool application::initialize_impl(int argc, char** argv, vector<abstract_plugin*
       vector<string> positionals = bpo::collect_unrecognized(parsed.options, bpo::include_positional);
       if(!positionals.empty())
          BOOST_THROW_EXCEPTION(std::runtime_error("Unknown option '" + positionals[0] + "' passed as command line argument"));
+      for(const auto& opt : options) {
+         if(!opt.second.defaulted())
+            my->_cli_options.insert(opt.first);
+      }
    } catch( const boost::program_options::unknown_option& e ) {
       BOOST_THROW_EXCEPTION(std::runtime_error("Unknown option '" + e.get_option_name() + "' passed as command line argument"));
    }
@@ -299,26 +454,35 @@ bool application::initialize_impl(int argc, char** argv, vector<abstract_plugin*
 
    std::vector<string> set_but_default_list;
 
+   // first entry of each option in the config file, so that every option is looked up once
+   std::unordered_map<string, const bpo::basic_option<char>*> config_entries;
+   config_entries.reserve(opts_from_config.size());
+   for(const bpo::basic_option<char>& opt : opts_from_config)
+      config_entries.emplace(opt.string_key, &opt);
+   const bool check_redundant = options.at("warn-redundant-config").as<bool>();
+
    for(const boost::shared_ptr<bpo::option_description>& od_ptr : my->_cfg_options.options()) {
       boost::any default_val, config_val;
       if(!od_ptr->semantic()->apply_default(default_val))
          continue;
 
-      if(my->_any_compare_map.find(default_val.type()) == my->_any_compare_map.end()) {
+      auto compare = my->_any_compare_map.find(default_val.type());
+      if(compare == my->_any_compare_map.end()) {
          std::cerr << "APPBASE: Developer -- the type " << default_val.type().name() << " is not registered with appbase," << std::endl;
          std::cerr << "         add a register_config_type<>() in your plugin's ctor" << std::endl;
          return false;
       }
 
-      for(const bpo::basic_option<char>& opt : opts_from_config) {
-         if(opt.string_key != od_ptr->long_name())
-            continue;
+      if(!check_redundant)
+         continue;
+      auto entry = config_entries.find(od_ptr->long_name());
+      if(entry == config_entries.end())
+         continue;
 
-         od_ptr->semantic()->parse(config_val, opt.value, true);
-         if(my->_any_compare_map.at(default_val.type())(default_val, config_val))
-            set_but_default_list.push_back(opt.string_key);
-         break;
-      }
+      // only options set in the config file are parsed again for the comparison
+      od_ptr->semantic()->parse(config_val, entry->second->value, true);
+      if(compare->second(default_val, config_val))
+         set_but_default_list.push_back(entry->first);
    }
    if(set_but_default_list.size()) {
       std::cerr << "APPBASE: Warning: The following configuration items in the config.ini file are redundantly set to" << std::endl;
@@ -346,34 +510,322 @@ bool application::initialize_impl(int argc, char** argv, vector<abstract_plugin*
       throw;
    }
 
+   my->_exec_batch_size = std::max<uint32_t>( options.at("exec-batch-size").as<uint32_t>(), 1 );
+   my->_exec_batch_time = std::chrono::microseconds( options.at("exec-batch-time-us").as<uint32_t>() );
+
+   const std::string scheduling = options.at("exec-scheduling").as<std::string>();
+   if( scheduling == "binary_heap" )
+      pri_queue.set_scheduling( execution_priority_queue::scheduling::binary_heap );
+   else if( scheduling == "bucketed" )
+      pri_queue.set_scheduling( execution_priority_queue::scheduling::bucketed );
+   else if( scheduling == "bucketed_fair" )
+      pri_queue.set_scheduling( execution_priority_queue::scheduling::bucketed_fair );
+   else
+      BOOST_THROW_EXCEPTION(std::runtime_error("Unknown exec-scheduling '" + scheduling + "'"));
+   pri_queue.set_starvation_limit( options.at("exec-starvation-limit").as<uint32_t>() );
+
+   my->_plugin_init_threads = std::max<uint32_t>( options.at("plugin-init-threads").as<uint32_t>(), 1 );
+   my->_shutdown_threads = std::max<uint32_t>( options.at("shutdown-threads").as<uint32_t>(), 1 );
+   const std::string idle = options.at("exec-idle-strategy").as<std::string>();
+   if( idle == "block" )
+      my->_idle_strategy = application_impl::idle_strategy::block;
+   else if( idle == "spin" )
+      my->_idle_strategy = application_impl::idle_strategy::spin;
+   else if( idle == "busy-poll" )
+      my->_idle_strategy = application_impl::idle_strategy::busy_poll;
+   else
+      BOOST_THROW_EXCEPTION(std::runtime_error("Unknown exec-idle-strategy '" + idle + "', expected block, spin or busy-poll"));
+   my->_idle_spin_time = std::chrono::microseconds( options.at("exec-idle-spin-us").as<uint32_t>() );
+   my->_print_wakeup_statistics = options.count("print-wakeup-statistics") > 0;
+   my->_shutdown_drain_time = std::chrono::milliseconds( options.at("shutdown-drain-ms").as<uint32_t>() );
+   my->_shutdown_drain_priority = options.at("shutdown-drain-priority").as<int>();
+   my->_shutdown_plugin_budget = std::chrono::milliseconds( options.at("shutdown-plugin-budget-ms").as<uint32_t>() );
+   bg_pool.configure( options.at("background-threads").as<uint32_t>(), options.at("background-pin-threads").as<bool>() );
+
+   thread_placement exec_placement;
+   exec_placement.sched_policy = thread_placement::parse_policy( options.at("exec-sched-policy").as<std::string>() );
+   exec_placement.sched_priority = options.at("exec-sched-priority").as<int>();
+   my->_exec_placement = my->_worker_placement = exec_placement;
+   my->_exec_placement.cpus = thread_placement::parse_cpus( options.at("exec-thread-cpus").as<std::string>() );
+   my->_worker_placement.cpus = thread_placement::parse_cpus( options.at("exec-worker-cpus").as<std::string>() );
+   my->_signal_placement.cpus = thread_placement::parse_cpus( options.at("signal-thread-cpus").as<std::string>() );
+   my->_print_startup_profile = options.count("print-startup-profile") > 0;
+   if( options.at("handler-watchdog-ms").as<uint32_t>() > 0 ) {
+      handler_watchdog::instance().start( std::chrono::milliseconds( options.at("handler-watchdog-ms").as<uint32_t>() ),
+                                          options.at("handler-watchdog-stack").as<bool>() );
+   }
+   if( options.at("trace-handlers").as<bool>() ) {
+      trace_recorder::instance().set_buffer_events( std::max<uint32_t>( options.at("trace-buffer-events").as<uint32_t>(), 1 ) );
+      trace_recorder::instance().set_enabled(true);
+   }
+
+   // plugins and everything they require, dependencies first: the order a sequential initialize would use
+   auto with_dependencies = [](const vector<abstract_plugin*>& roots) {
+      vector<abstract_plugin*> result;
+      std::set<abstract_plugin*> visited;
+      std::function<void(abstract_plugin&)> visit = [&](abstract_plugin& plugin) {
+         if( plugin.get_state() != abstract_plugin::registered || !visited.insert(&plugin).second )
+            return;
+         plugin.visit_dependencies(visit);
+         result.push_back(&plugin);
+      };
+      for( auto plugin : roots )
+         visit(*plugin);
+      return result;
+   };
+   auto initialize_plugin = [&options](abstract_plugin& plugin) { plugin.initialize(options); };
+   auto never_stop = []() { return false; };
+
+   const auto plugins_start = std::chrono::steady_clock::now();
+   my->_profile.options = std::chrono::duration_cast<std::chrono::microseconds>(plugins_start - options_start);
+   auto record_initialize = [&]() {
+      my->_profile.initialize = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - plugins_start);
+   };
+
    if(options.count("plugin") > 0)
    {
+      vector<abstract_plugin*> enabled;
       auto plugins = options.at("plugin").as<std::vector<std::string>>();
       for(auto& arg : plugins)
       {
          vector<string> names;
          boost::split(names, arg, boost::is_any_of(" \t,"));
          for(const std::string& name : names)
-            get_plugin(name).initialize(options);
+            enabled.push_back(&get_plugin(name));
       }
+      my->_initialize_critical_path = run_plugins(with_dependencies(enabled), my->_plugin_init_threads, initialize_plugin, never_stop,
+                                                  &plugin_profile::initialize);
    }
    try {
+      vector<abstract_plugin*> autostart;
       for (auto plugin : autostart_plugins)
-         if (plugin != nullptr && plugin->get_state() == abstract_plugin::registered)
-            plugin->initialize(options);
+         if (plugin != nullptr)
+            autostart.push_back(plugin);
+      auto path = run_plugins(with_dependencies(autostart), my->_plugin_init_threads, initialize_plugin, never_stop,
+                              &plugin_profile::initialize);
+      if( path.length > my->_initialize_critical_path.length )
+         my->_initialize_critical_path.plugins = std::move(path.plugins);
+      my->_initialize_critical_path.length = std::max(my->_initialize_critical_path.length, path.length);
+      my->_initialize_critical_path.total += path.total;
    } catch (...) {
+      record_initialize();
       std::cerr << "Failed to initialize\n";
       return false;
    }
+   record_initialize();
 
    return true;
 }
 
-void application::shutdown() {
-   for(auto ritr = running_plugins.rbegin();
-       ritr != running_plugins.rend(); ++ritr) {
-      (*ritr)->shutdown();
+plugin_critical_path application::run_plugins(const vector<abstract_plugin*>& plugins, size_t num_threads,
+                                              const std::function<void(abstract_plugin&)>& action,
+                                              const std::function<bool()>& stop,
+                                              std::chrono::microseconds plugin_profile::* step,
+                                              bool dependents_first) {
+   using std::chrono::microseconds;
+   struct node {
+      size_t         waiting_for = 0;      ///< plugins that have to be done first
+      vector<size_t> dependents;           ///< plugins waiting for this one
+      microseconds   path{0};              ///< longest chain of durations ending with this plugin
+      size_t         path_prev = SIZE_MAX; ///< the dependency that chain comes through
+   };
+
+   const size_t n = plugins.size();
+   vector<node> nodes(n);
+   std::map<abstract_plugin*, size_t> index;
+   for( size_t i = 0; i < n; ++i )
+      index.emplace(plugins[i], i);
+   for( size_t i = 0; i < n; ++i ) {
+      plugins[i]->visit_dependencies([&](abstract_plugin& dep) {
+         auto itr = index.find(&dep);
+         if( itr == index.end() || itr->second == i )
+            return;
+         const size_t first = dependents_first ? i : itr->second;
+         const size_t then = dependents_first ? itr->second : i;
+         ++nodes[then].waiting_for;
+         nodes[first].dependents.push_back(then);
+      });
    }
+
+   std::mutex mtx;
+   std::condition_variable cv;
+   std::set<size_t> ready; ///< lowest index first, which with one thread is the sequential order
+   size_t running = 0;
+   size_t done = 0;
+   std::exception_ptr error;
+   plugin_critical_path result;
+   for( size_t i = 0; i < n; ++i )
+      if( nodes[i].waiting_for == 0 )
+         ready.insert(i);
+
+   auto worker = [&]() {
+      std::unique_lock<std::mutex> g(mtx);
+      while( true ) {
+         cv.wait(g, [&]() { return !ready.empty() || running == 0 || error; });
+         if( error || ready.empty() || stop() )
+            break;
+         const size_t i = *ready.begin();
+         ready.erase(ready.begin());
+         ++running;
+         g.unlock();
+
+         auto start = std::chrono::steady_clock::now();
+         std::exception_ptr action_error;
+         try {
+            action(*plugins[i]);
+         } catch( ... ) {
+            action_error = std::current_exception();
+         }
+         auto duration = std::chrono::duration_cast<microseconds>(std::chrono::steady_clock::now() - start);
+
+         g.lock();
+         --running;
+         ++done;
+         if( action_error && !error )
+            error = action_error;
+         {
+            std::lock_guard<std::mutex> pg(plugin_state_mtx);
+            profile_of(*plugins[i]).*step += duration;
+         }
+         nodes[i].path += duration;
+         result.total += duration;
+         for( size_t d : nodes[i].dependents ) {
+            if( nodes[i].path > nodes[d].path ) {
+               nodes[d].path = nodes[i].path;
+               nodes[d].path_prev = i;
+            }
+            if( --nodes[d].waiting_for == 0 )
+               ready.insert(d);
+         }
+         cv.notify_all();
+      }
+      cv.notify_all();
+   };
+
+   // plugins look up other plugins, methods and channels while they run, which then takes registry_mtx
+   const bool concurrent = std::min(num_threads, n) > 1;
+   if( concurrent )
+      concurrent_plugins.store(true, std::memory_order_release);
+   vector<std::thread> threads;
+   try {
+      for( size_t t = 1; t < std::min(num_threads, n); ++t )
+         threads.emplace_back(worker);
+   } catch( ... ) {
+      std::lock_guard<std::mutex> g(mtx);
+      if( !error )
+         error = std::current_exception();
+   }
+   worker();
+   for( auto& t : threads )
+      t.join();
+   if( concurrent )
+      concurrent_plugins.store(false, std::memory_order_release);
+
+   if( error )
+      std::rethrow_exception(error);
+
+   // a dependency cycle leaves plugins that never became ready, run those in order, each resolving its own requires
+   if( done < n && !stop() ) {
+      for( size_t i = 0; i < n; ++i ) {
+         if( nodes[i].waiting_for > 0 )
+            action(*plugins[i]);
+      }
+   }
+
+   size_t last = SIZE_MAX;
+   for( size_t i = 0; i < n; ++i ) {
+      if( last == SIZE_MAX || nodes[i].path > nodes[last].path )
+         last = i;
+   }
+   if( last != SIZE_MAX ) {
+      result.length = nodes[last].path;
+      for( size_t i = last; i != SIZE_MAX; i = nodes[i].path_prev )
+         result.plugins.push_back(plugins[i]->name());
+      std::reverse(result.plugins.begin(), result.plugins.end());
+   }
+   return result;
+}
+
+plugin_profile& application::profile_of(abstract_plugin& plug) {
+   auto itr = my->_profile_index.find(&plug);
+   if( itr == my->_profile_index.end() ) {
+      itr = my->_profile_index.emplace(&plug, my->_profile.plugins.size()).first;
+      my->_profile.plugins.push_back(plugin_profile{plug.name()});
+   }
+   return my->_profile.plugins[itr->second];
+}
+
+const lifecycle_profile& application::get_lifecycle_profile() const {
+   return my->_profile;
+}
+
+void application::print_lifecycle_profile(std::ostream& os) const {
+   auto ms = [](std::chrono::microseconds us) {
+      std::ostringstream ss;
+      ss << std::fixed << std::setprecision(3) << us.count() / 1000.0;
+      return ss.str();
+   };
+   const auto& p = my->_profile;
+   size_t width = 6;
+   for( const auto& plug : p.plugins )
+      width = std::max(width, plug.name.size());
+
+   os << "APPBASE: lifecycle profile (ms)" << std::endl;
+   os << "   options " << ms(p.options) << ", initialize " << ms(p.initialize) << ", startup " << ms(p.startup)
+      << ", shutdown " << ms(p.shutdown) << std::endl;
+   os << "   " << std::left << std::setw(width) << "plugin" << std::right
+      << std::setw(14) << "initialize" << std::setw(14) << "startup" << std::setw(14) << "shutdown" << std::endl;
+   for( const auto& plug : p.plugins ) {
+      os << "   " << std::left << std::setw(width) << plug.name << std::right
+         << std::setw(14) << ms(plug.initialize) << std::setw(14) << ms(plug.startup) << std::setw(14) << ms(plug.shutdown) << std::endl;
+   }
+   auto print_path = [&](const char* phase, const plugin_critical_path& path) {
+      if( path.plugins.empty() )
+         return;
+      os << "   " << phase << " critical path " << ms(path.length) << " of " << ms(path.total) << ":";
+      for( const auto& name : path.plugins )
+         os << " " << name;
+      os << std::endl;
+   };
+   print_path("initialize", my->_initialize_critical_path);
+   print_path("startup", my->_startup_critical_path);
+   print_path("shutdown", my->_shutdown_critical_path);
+}
+
+const plugin_critical_path& application::initialize_critical_path() const {
+   return my->_initialize_critical_path;
+}
+
+const plugin_critical_path& application::startup_critical_path() const {
+   return my->_startup_critical_path;
+}
+
+const plugin_critical_path& application::shutdown_critical_path() const {
+   return my->_shutdown_critical_path;
+}
+
+void application::shutdown() {
+   stop_trace_signal_thread();
+   handler_watchdog::instance().stop();
+   const auto shutdown_start = std::chrono::steady_clock::now();
+   const auto budget = my->_shutdown_plugin_budget;
+   my->_shutdown_critical_path = run_plugins( vector<abstract_plugin*>(running_plugins.rbegin(), running_plugins.rend()), my->_shutdown_threads,
+                                              [budget](abstract_plugin& plugin) {
+                                                 const auto start = std::chrono::steady_clock::now();
+                                                 plugin.shutdown();
+                                                 const auto took = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+                                                 if( budget.count() && took > budget )
+                                                    std::cerr << "APPBASE: Plugin " << plugin.name() << " took " << took.count() << " ms to shut down, over the "
+                                                              << "shutdown-plugin-budget-ms of " << budget.count() << " ms" << std::endl;
+                                              },
+                                              []() { return false; },
+                                              &plugin_profile::shutdown, true );
+   bg_pool.stop(); // background handlers may still use the plugins
+   my->_profile.shutdown = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - shutdown_start);
+   my->_profile_index.clear(); // keyed by plugins destroyed below
+   if( my->_print_startup_profile && !running_plugins.empty() )
+      print_lifecycle_profile(std::cerr);
+   plugin_cache.clear(); // points to plugins destroyed below
    for(auto ritr = running_plugins.rbegin();
        ritr != running_plugins.rend(); ++ritr) {
       plugins.erase((*ritr)->name());
@@ -411,20 +863,251 @@ void application::set_thread_priority_max() {
 #endif
 }
 
-void application::exec() {
+void application::schedule_timer(std::chrono::steady_clock::time_point deadline, int priority, impl::handler_function&& func) {
+   {
+      std::lock_guard<std::mutex> g(my->_timers_mtx);
+      my->_timers.add(deadline, priority, std::move(func));
+      // the armed timer fires no later than the new one is due, advance() then fires it or re-arms for it
+      if( deadline >= my->_timer_armed_at )
+         return;
+      const auto next = my->_timers.next_event();
+      if( next >= my->_timer_armed_at )
+         return;
+      my->_timer_armed_at = next;
+   }
+   boost::asio::post(*io_serv, [this]() { arm_timer(); });
+}
+
+void application::arm_timer() {
+   std::chrono::steady_clock::time_point next;
+   {
+      std::lock_guard<std::mutex> g(my->_timers_mtx);
+      next = my->_timers.next_event();
+      my->_timer_armed_at = next;
+   }
+   if( next == std::chrono::steady_clock::time_point::max() )
+      return;
+   if( !my->_wheel_timer )
+      my->_wheel_timer = std::make_unique<boost::asio::steady_timer>(*io_serv);
+   my->_wheel_timer->expires_at(next);
+   my->_wheel_timer->async_wait([this](const boost::system::error_code& ec) {
+      if( ec == boost::asio::error::operation_aborted )
+         return;
+      {
+         std::lock_guard<std::mutex> g(my->_timers_mtx);
+         my->_timers.advance(std::chrono::steady_clock::now(), [this](int priority, impl::handler_function&& f) {
+            my->_expired_timers.emplace_back(priority, std::move(f));
+         });
+      }
+      for( auto& expired : my->_expired_timers )
+         pri_queue.add(expired.first, std::move(expired.second));
+      my->_expired_timers.clear();
+      arm_timer();
+   });
+}
+
+void application::exec(size_t num_threads) {
+   std::exception_ptr worker_exception;
    {
       boost::asio::io_service::work work(*io_serv);
       (void)work;
-      bool more = true;
-      while( more || io_serv->run_one() ) {
-         while( io_serv->poll_one() ) {}
-         // execute the highest priority item
-         more = pri_queue.execute_highest();
+
+      std::mutex worker_exception_mtx;
+      std::vector<std::thread> workers;
+      auto stop_workers = [&]() {
+         if( workers.empty() ) return;
+         pri_queue.stop_workers();
+         for( auto& t : workers )
+            t.join();
+         workers.clear();
+         pri_queue.set_multi_threaded(false);
+      };
+      if( num_threads > 1 ) {
+         pri_queue.set_multi_threaded(true);
+         for( size_t i = 1; i < num_threads; ++i ) {
+            workers.emplace_back([&]() {
+               try {
+                  const std::string placement_error = my->_worker_placement.apply_to_current_thread();
+                  if( !placement_error.empty() )
+                     BOOST_THROW_EXCEPTION(std::runtime_error("Unable to apply exec-worker-cpus / exec-sched-policy: " + placement_error));
+                  pri_queue.run_worker();
+               } catch( ... ) {
+                  std::lock_guard<std::mutex> g(worker_exception_mtx);
+                  if( !worker_exception )
+                     worker_exception = std::current_exception();
+                  quit();
+               }
+            });
+         }
+      }
+
+      bool drain_stopped = false;
+      try {
+         bool more = true;
+         auto drain_deadline = std::chrono::steady_clock::time_point::max();
+         while( more || wait_for_work() ) {
+            while( io_serv->poll_one() ) {}
+            // execute the highest priority items
+            more = pri_queue.execute_batch( my->_exec_batch_size, my->_exec_batch_time );
+            if( more && is_quiting() ) {
+               // after quit() the queue is drained, down to shutdown-drain-priority and until shutdown-drain-ms
+               const auto now = std::chrono::steady_clock::now();
+               if( drain_deadline == std::chrono::steady_clock::time_point::max() && my->_shutdown_drain_time.count() )
+                  drain_deadline = now + my->_shutdown_drain_time;
+               if( now >= drain_deadline || !pri_queue.has_priority_at_least( my->_shutdown_drain_priority ) ) {
+                  drain_stopped = true;
+                  break;
+               }
+            }
+         }
+         if( !drain_stopped && is_quiting() && my->_shutdown_drain_time.count() && pri_queue.outstanding_work() ) {
+            // asynchronous operations completing on the queue (pri_queue.wrap) may still finish within shutdown-drain-ms
+            if( drain_deadline == std::chrono::steady_clock::time_point::max() )
+               drain_deadline = std::chrono::steady_clock::now() + my->_shutdown_drain_time;
+            io_serv->restart();
+            while( std::chrono::steady_clock::now() < drain_deadline ) {
+               while( io_serv->poll_one() ) {}
+               if( pri_queue.size() && !pri_queue.has_priority_at_least( my->_shutdown_drain_priority ) ) {
+                  drain_stopped = true;
+                  break;
+               }
+               if( pri_queue.execute_batch( my->_exec_batch_size, my->_exec_batch_time ) )
+                  continue;
+               if( !pri_queue.outstanding_work() )
+                  break;
+               io_serv->run_one_until( drain_deadline );
+            }
+            io_serv->stop();
+            drain_stopped = drain_stopped || pri_queue.size();
+         }
+      } catch( ... ) {
+         stop_workers();
+         throw;
+      }
+      stop_workers();
+      if( drain_stopped ) {
+         // destroyed while the plugins their functions may refer to still exist
+         size_t dropped = 0;
+         for( ; pri_queue.size(); ++dropped )
+            pri_queue.take_highest();
+         if( dropped )
+            std::cerr << "APPBASE: Shutdown dropped " << dropped << " queued handlers" << std::endl;
       }
 
       shutdown(); /// perform synchronous shutdown
+
+      if( my->_print_wakeup_statistics )
+         print_wakeup_statistics(std::cerr);
+
+      my->_wheel_timer.reset();
+      std::lock_guard<std::mutex> g(my->_timers_mtx);
+      my->_timers.clear();
+      my->_timer_armed_at = std::chrono::steady_clock::time_point::max();
    }
    io_serv.reset();
+   if( worker_exception )
+      std::rethrow_exception( worker_exception );
+}
+
+bool application::wait_for_work() {
+   using clock = std::chrono::steady_clock;
+   if( my->_idle_strategy == application_impl::idle_strategy::block )
+      return io_serv->run_one();
+
+   const auto spin_until = my->_idle_strategy == application_impl::idle_strategy::spin ? clock::now() + my->_idle_spin_time
+                                                                                        : clock::time_point::max();
+   for( uint32_t spins = 1; !io_serv->stopped(); ++spins ) {
+      if( pri_queue.drain_pending() ) {
+         // take the posted handlers without waiting for the io_service handler post() queued
+         record_wakeup(true);
+         pri_queue.drain_ingress();
+         return true;
+      }
+      // polling the io_service for timers and sockets may enter the kernel, so it is done less often
+      if( spins % 64 == 0 ) {
+         if( io_serv->poll_one() )
+            return true;
+         if( clock::now() >= spin_until )
+            break;
+      }
+      impl::cpu_relax();
+   }
+   return io_serv->run_one();
+}
+
+void application::record_wakeup(bool spinning) {
+   int64_t requested = wake_requested.exchange(0, std::memory_order_acquire);
+   // a spinning exec() can see the post before its timestamp
+   for( int n = 0; !requested && spinning && n < 1000; ++n ) {
+      impl::cpu_relax();
+      requested = wake_requested.exchange(0, std::memory_order_acquire);
+   }
+   if( !requested )
+      return;
+   const auto latency = std::max(std::chrono::nanoseconds(0), std::chrono::steady_clock::now().time_since_epoch()
+                                                                 - std::chrono::steady_clock::duration(requested));
+   std::lock_guard<std::mutex> g(my->_wakeup_mtx);
+   auto& w = my->_wakeups;
+   ++w.wakeups;
+   if( spinning )
+      ++w.spin_wakeups;
+   w.total_latency += latency;
+   w.max_latency = std::max(w.max_latency, latency);
+   ++w.latency_ns[impl::histogram_bucket(latency.count())];
+}
+
+wakeup_statistics application::get_wakeup_statistics() const {
+   std::lock_guard<std::mutex> g(my->_wakeup_mtx);
+   return my->_wakeups;
+}
+
+void application::print_wakeup_statistics(std::ostream& os) const {
+   const wakeup_statistics w = get_wakeup_statistics();
+   // upper bound of the histogram bucket holding the given fraction of the wakeups
+   auto percentile = [&w](double fraction) {
+      uint64_t seen = 0;
+      for( size_t b = 0; b < w.latency_ns.size(); ++b ) {
+         seen += w.latency_ns[b];
+         if( seen && seen >= fraction * w.wakeups )
+            return b ? (uint64_t(1) << b) / 1000.0 : 0.0;
+      }
+      return 0.0;
+   };
+   os << "APPBASE: exec() wakeups " << w.wakeups << " (" << w.spin_wakeups << " while spinning), latency mean "
+      << std::fixed << std::setprecision(3) << (w.wakeups ? w.total_latency.count() / 1000.0 / w.wakeups : 0.0)
+      << " us, p50 < " << percentile(0.5) << " us, p99 < " << percentile(0.99) << " us, max " << w.max_latency.count() / 1000.0 << " us"
+      << std::endl;
+}
+
+void strand::schedule(int priority) {
+   _scheduled = true;
+   _scheduled_priority = priority;
+   app().post( priority, [this, generation = ++_generation]() { run_next(generation); } );
+}
+
+void strand::run_next(uint64_t generation) {
+   std::unique_lock<std::mutex> g(_mtx);
+   if( generation != _generation || _running )
+      return;
+   _scheduled = false;
+   if( _pending.empty() )
+      return;
+   std::pop_heap(_pending.begin(), _pending.end());
+   impl::handler_function handler = std::move(_pending.back().function);
+   _pending.pop_back();
+   _running = true;
+   g.unlock();
+
+   struct reschedule_on_exit {
+      strand& s;
+      ~reschedule_on_exit() {
+         std::lock_guard<std::mutex> g(s._mtx);
+         s._running = false;
+         if( !s._pending.empty() )
+            s.schedule(s._pending.front().priority);
+      }
+   } guard{*this};
+   handler();
 }
 
 void application::write_default_config(const bfs::path& cfg_file) {
@@ -482,6 +1165,7 @@ void application::print_default_config(std::ostream& os) {
 
 abstract_plugin* application::find_plugin(const string& name)const
 {
+   auto lock = registry_lock();
    auto itr = plugins.find(name);
    if(itr == plugins.end()) {
       return nullptr;
@@ -516,4 +1200,63 @@ const bpo::variables_map& application::get_options() const{
       return my->_options;
 }
 
+vector<string> application::reload_config() {
+   bpo::variables_map fresh;
+   try {
+      bpo::store(bpo::parse_config_file<char>(my->_config_file_name.make_preferred().string().c_str(), my->_cfg_options, false), fresh);
+   } catch( const std::exception& e ) {
+      std::cerr << "APPBASE: Unable to reload the config file " << full_config_file_path().string() << ", keeping the current configuration: "
+                << e.what() << std::endl;
+      return {};
+   }
+
+   bpo::variables_map& options = my->_options;
+   vector<string> changed;
+   std::map<abstract_plugin*, bpo::variables_map> changed_by_plugin;
+   vector<string> app_changed;
+   for(const boost::shared_ptr<bpo::option_description>& od_ptr : my->_cfg_options.options()) {
+      const string& key = od_ptr->long_name();
+      if(my->_cli_options.count(key))
+         continue;
+      auto current = options.find(key);
+      auto reloaded = fresh.find(key);
+      const bool had = current != options.end() && !current->second.empty();
+      const bool has = reloaded != fresh.end() && !reloaded->second.empty();
+      if(!had && !has)
+         continue;
+      if(had && has && current->second.value().type() == reloaded->second.value().type()) {
+         auto compare = my->_any_compare_map.find(current->second.value().type());
+         if(compare != my->_any_compare_map.end() && compare->second(current->second.value(), reloaded->second.value()))
+            continue;
+      }
+
+      changed.push_back(key);
+      if(had)
+         options.erase(current);
+      if(has) {
+         options.insert(*reloaded);
+         od_ptr->semantic()->notify(reloaded->second.value());
+      }
+      auto owner = my->_option_owners.find(key);
+      if(owner == my->_option_owners.end())
+         app_changed.push_back(key);
+      else if(has)
+         changed_by_plugin[owner->second].insert(*reloaded);
+      else
+         changed_by_plugin[owner->second].insert(std::make_pair(key, bpo::variable_value()));
+   }
+
+   std::cerr << "APPBASE: Reloaded the config file " << full_config_file_path().string() << ", "
+             << (changed.empty() ? string("no options changed") : "changed: " + boost::algorithm::join(changed, ", ")) << std::endl;
+   if(!app_changed.empty())
+      std::cerr << "APPBASE: Changed application options take effect on restart: " << boost::algorithm::join(app_changed, ", ") << std::endl;
+
+   for(auto plugin : initialized_plugins) {
+      auto itr = changed_by_plugin.find(plugin);
+      if(itr != changed_by_plugin.end())
+         plugin->handle_config_changed(itr->second);
+   }
+   return changed;
+}
+
 } /// namespace appbase
@@ -0,0 +1,56 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace appbase { namespace bench {
+
+   using clock = std::chrono::steady_clock;
+
+   struct benchmark {
+      std::string           name;
+      std::function<void()> run;
+   };
+
+   /**
+    * All benchmarks linked into appbase_bench, in registration order
+    */
+   std::vector<benchmark>& registry();
+
+   struct registrar {
+      registrar(std::string name, std::function<void()> run) {
+         registry().push_back({std::move(name), std::move(run)});
+      }
+   };
+
+   /**
+    * Report one measurement as a single line: <benchmark> <params> <value> <unit>
+    */
+   void report(const std::string& name, const std::string& params, double value, const std::string& unit);
+
+   inline double seconds_since(clock::time_point start) {
+      return std::chrono::duration<double>(clock::now() - start).count();
+   }
+
+   extern volatile uint64_t optimization_sink;
+
+   /**
+    * Keep the compiler from optimizing away the computation of an arithmetic result
+    */
+   template<typename T>
+   inline void do_not_optimize(T v) {
+      optimization_sink = static_cast<uint64_t>(v);
+   }
+
+} } // appbase::bench
+
+#define APPBASE_BENCHMARK_CAT_IMPL(a, b) a##b
+#define APPBASE_BENCHMARK_CAT(a, b) APPBASE_BENCHMARK_CAT_IMPL(a, b)
+
+/**
+ * Register a benchmark function with appbase_bench
+ */
+#define APPBASE_BENCHMARK(NAME, FUNC) \
+   static appbase::bench::registrar APPBASE_BENCHMARK_CAT(_appbase_bench_, __LINE__)( NAME, FUNC )
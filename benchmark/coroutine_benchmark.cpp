@@ -0,0 +1,79 @@
+#include "benchmark.hpp"
+
+#include <appbase/application.hpp>
+
+#ifdef APPBASE_HAS_COROUTINES
+#include <string>
+
+using namespace appbase;
+
+namespace {
+
+   struct loop_state {
+      uint64_t sum = 0;
+      size_t   running = 0;
+   };
+
+   task yield_loop(size_t steps, loop_state& state) {
+      for( size_t n = 0; n < steps; ++n ) {
+         state.sum += n;
+         co_await app().yield(priority::medium);
+      }
+      --state.running;
+   }
+
+   /// the same loop written as a handler that posts itself again, carrying its state
+   struct repost_loop {
+      size_t      n;
+      size_t      steps;
+      loop_state* state;
+
+      void operator()() {
+         state->sum += n;
+         if( ++n < steps )
+            app().post(priority::medium, repost_loop(*this));
+         else
+            --state->running;
+      }
+   };
+
+   void run_queue(const loop_state& state) {
+      // same work as exec(): run the io_service wake-ups that drain the ingress, then the queued handlers
+      while( state.running ) {
+         app().get_io_service().restart();
+         app().get_io_service().poll();
+         app().get_priority_queue().execute_all();
+      }
+   }
+
+   /**
+    * Resuming a coroutine from the priority queue with co_await app().yield() vs. posting a continuation
+    * handler, with a number of coroutines or handler chains interleaved on the queue
+    */
+   void coroutine_yield() {
+      constexpr size_t steps = 1000000;
+      for( size_t chains : {1, 100} ) {
+         loop_state state{0, chains};
+         auto start = bench::clock::now();
+         for( size_t c = 0; c < chains; ++c )
+            yield_loop(steps / chains, state);
+         run_queue(state);
+         double elapsed = bench::seconds_since(start);
+         bench::do_not_optimize(state.sum);
+         bench::report("coroutine_yield", "impl=coroutine chains=" + std::to_string(chains), elapsed * 1e9 / steps, "ns/step");
+
+         state = loop_state{0, chains};
+         start = bench::clock::now();
+         for( size_t c = 0; c < chains; ++c )
+            app().post(priority::medium, repost_loop{0, steps / chains, &state});
+         run_queue(state);
+         elapsed = bench::seconds_since(start);
+         bench::do_not_optimize(state.sum);
+         bench::report("coroutine_yield", "impl=post chains=" + std::to_string(chains), elapsed * 1e9 / steps, "ns/step");
+      }
+   }
+
+} // namespace
+
+APPBASE_BENCHMARK("coroutine_yield", coroutine_yield);
+#endif
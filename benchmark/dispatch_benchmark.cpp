@@ -0,0 +1,233 @@
+#include "benchmark.hpp"
+
+#include <appbase/application.hpp>
+
+#include <array>
+#include <functional>
+#include <future>
+#include <string>
+#include <vector>
+
+using namespace appbase;
+
+namespace {
+
+   template<typename Backend>
+   struct backend_name;
+   template<> struct backend_name<signals2_backend> { static constexpr const char* value = "signals2"; };
+   template<> struct backend_name<flat_backend>     { static constexpr const char* value = "flat"; };
+
+   /**
+    * Synchronous method call overhead with a single provider, which is what a method call costs beyond
+    * calling the provider itself; a single provider is called directly, without going through the backend
+    */
+   template<typename Backend>
+   void run_method_call(size_t providers) {
+      using decl = method_decl<struct method_call_tag, int(int), first_provider_policy, Backend>;
+      constexpr size_t calls = 2000000;
+      auto& m = app().get_method<decl>();
+      std::vector<typename decl::method_type::handle> handles;
+      for( size_t p = 0; p < providers; ++p )
+         handles.push_back(m.register_provider([](int v) { return v + 1; }));
+
+      int v = 0;
+      auto start = bench::clock::now();
+      for( size_t n = 0; n < calls; ++n )
+         v = m(std::move(v));
+      double elapsed = bench::seconds_since(start);
+      bench::do_not_optimize(v);
+      bench::report("method_call", std::string("backend=") + backend_name<Backend>::value + " providers=" + std::to_string(providers),
+                    elapsed * 1e9 / calls, "ns/call");
+   }
+
+   void method_call() {
+      for( size_t providers : {1, 2} ) {
+         run_method_call<signals2_backend>(providers);
+         run_method_call<flat_backend>(providers);
+      }
+
+      // the same provider called through a plain std::function, for reference
+      constexpr size_t calls = 2000000;
+      std::function<int(int)> f = [](int v) { return v + 1; };
+      int v = 0;
+      auto start = bench::clock::now();
+      for( size_t n = 0; n < calls; ++n )
+         v = f(v);
+      double elapsed = bench::seconds_since(start);
+      bench::do_not_optimize(v);
+      bench::report("method_call", "backend=std_function providers=1", elapsed * 1e9 / calls, "ns/call");
+   }
+
+   /**
+    * method::call_async() with a single provider executed by the queue, which is what
+    * moving a call off the calling thread costs: posting the call, running it and fulfilling its future
+    */
+   void method_call_async() {
+      using decl = method_decl<struct method_call_async_tag, int(int), first_provider_policy, flat_backend>;
+      constexpr size_t burst = 10000;
+      constexpr size_t bursts = 50;
+      auto& m = app().get_method<decl>();
+      auto provider = m.register_provider([](int v) { return v + 1; });
+      std::vector<std::future<int>> results;
+      results.reserve(burst);
+
+      int sum = 0;
+      auto start = bench::clock::now();
+      for( size_t b = 0; b < bursts; ++b ) {
+         for( size_t n = 0; n < burst; ++n )
+            results.push_back(m.call_async(priority::medium, int(n)));
+         app().get_io_service().restart();
+         app().get_io_service().poll();
+         app().get_priority_queue().execute_all();
+         for( auto& r : results )
+            sum += r.get();
+         results.clear();
+      }
+      double elapsed = bench::seconds_since(start);
+      bench::do_not_optimize(sum);
+      bench::report("method_call_async", "backend=flat", elapsed * 1e9 / (burst * bursts), "ns/call");
+   }
+
+   /**
+    * Cost of resolving a method declaration through app().get_method<>() once it exists
+    */
+   void method_lookup() {
+      using decl = method_decl<struct method_lookup_tag, void()>;
+      constexpr size_t lookups = 2000000;
+      app().get_method<decl>();
+
+      auto start = bench::clock::now();
+      for( size_t n = 0; n < lookups; ++n )
+         bench::do_not_optimize(reinterpret_cast<uintptr_t>(&app().get_method<decl>()));
+      double elapsed = bench::seconds_since(start);
+      bench::report("method_lookup", "decls=1", elapsed * 1e9 / lookups, "ns/lookup");
+   }
+
+   class lookup_plugin : public plugin<lookup_plugin> {
+      public:
+         APPBASE_PLUGIN_REQUIRES();
+         void set_program_options( options_description&, options_description& ) override {}
+         void plugin_initialize( const variables_map& ) {}
+         void plugin_startup() {}
+         void plugin_shutdown() {}
+   };
+
+   /**
+    * Cost of app().find_plugin<>() for a registered plugin, which resolves through a per-type slot, vs. looking
+    * it up by name
+    */
+   void plugin_lookup() {
+      constexpr size_t lookups = 2000000;
+      app().register_plugin<lookup_plugin>();
+
+      auto start = bench::clock::now();
+      for( size_t n = 0; n < lookups; ++n )
+         bench::do_not_optimize(reinterpret_cast<uintptr_t>(app().find_plugin<lookup_plugin>()));
+      double elapsed = bench::seconds_since(start);
+      bench::report("plugin_lookup", "by=type", elapsed * 1e9 / lookups, "ns/lookup");
+
+      const std::string name = app().get_plugin<lookup_plugin>().name();
+      start = bench::clock::now();
+      for( size_t n = 0; n < lookups; ++n )
+         bench::do_not_optimize(reinterpret_cast<uintptr_t>(app().find_plugin(name)));
+      elapsed = bench::seconds_since(start);
+      bench::report("plugin_lookup", "by=name", elapsed * 1e9 / lookups, "ns/lookup");
+   }
+
+   /**
+    * Publish to dispatch throughput of a burst of small items, one publish per item vs. one publish_batch
+    */
+   void channel_publish() {
+      using decl = channel_decl<struct channel_publish_tag, uint64_t>;
+      constexpr size_t burst = 10000;
+      constexpr size_t bursts = 50;
+      auto& ch = app().get_channel<decl>();
+      uint64_t sum = 0;
+      auto sub = ch.subscribe([&sum](const uint64_t& v) { sum += v; });
+      std::vector<uint64_t> items(burst, 1);
+
+      for( bool batched : {false, true} ) {
+         auto start = bench::clock::now();
+         for( size_t b = 0; b < bursts; ++b ) {
+            if( batched ) {
+               ch.publish_batch(priority::medium, items);
+            } else {
+               for( uint64_t v : items )
+                  ch.publish(priority::medium, v);
+            }
+            // same work as exec(): run the io_service wake-ups that drain the ingress, then the queued dispatches
+            // poll() leaves the io_service stopped once it runs out of work
+            app().get_io_service().restart();
+            app().get_io_service().poll();
+            app().get_priority_queue().execute_all();
+         }
+         double elapsed = bench::seconds_since(start);
+         bench::report("channel_publish", std::string("mode=") + (batched ? "batch" : "single") + " burst=" + std::to_string(burst),
+                       burst * bursts / elapsed, "items/s");
+      }
+      bench::do_not_optimize(sum);
+      sub.unsubscribe();
+   }
+
+   template<size_t Size>
+   struct payload {
+      std::array<char, Size> bytes{};
+   };
+
+   template<size_t Size>
+   struct fanout_tag;
+
+   /**
+    * Publish to dispatch throughput of a channel with a number of subscribers and a payload of Size bytes,
+    * every item is delivered to every subscriber
+    */
+   template<typename Backend, size_t Size>
+   void run_channel_fanout(size_t subscribers) {
+      using decl = channel_decl<fanout_tag<Size>, payload<Size>, drop_exceptions, Backend>;
+      constexpr size_t burst = 1000;
+      constexpr size_t bursts = 50;
+      auto& ch = app().get_channel<decl>();
+      uint64_t received = 0;
+      std::vector<typename decl::channel_type::handle> handles;
+      for( size_t s = 0; s < subscribers; ++s )
+         handles.push_back(ch.subscribe([&received](const payload<Size>& p) { received += p.bytes[0] + 1; }));
+      payload<Size> item;
+
+      auto start = bench::clock::now();
+      for( size_t b = 0; b < bursts; ++b ) {
+         for( size_t n = 0; n < burst; ++n )
+            ch.publish(priority::medium, item);
+         app().get_io_service().restart();
+         app().get_io_service().poll();
+         app().get_priority_queue().execute_all();
+      }
+      double elapsed = bench::seconds_since(start);
+      bench::do_not_optimize(received);
+      for( auto& h : handles )
+         h.unsubscribe();
+      bench::report("channel_fanout", std::string("backend=") + backend_name<Backend>::value + " subscribers=" + std::to_string(subscribers) +
+                    " payload=" + std::to_string(Size), burst * bursts / elapsed, "items/s");
+   }
+
+   template<typename Backend>
+   void run_channel_fanout_sizes() {
+      for( size_t subscribers : {1, 4, 16} ) {
+         run_channel_fanout<Backend, 8>(subscribers);
+         run_channel_fanout<Backend, 256>(subscribers);
+         run_channel_fanout<Backend, 4096>(subscribers);
+      }
+   }
+
+   void channel_fanout() {
+      run_channel_fanout_sizes<signals2_backend>();
+      run_channel_fanout_sizes<flat_backend>();
+   }
+
+} // namespace
+
+APPBASE_BENCHMARK("method_call", method_call);
+APPBASE_BENCHMARK("method_call_async", method_call_async);
+APPBASE_BENCHMARK("method_lookup", method_lookup);
+APPBASE_BENCHMARK("plugin_lookup", plugin_lookup);
+APPBASE_BENCHMARK("channel_publish", channel_publish);
+APPBASE_BENCHMARK("channel_fanout", channel_fanout);
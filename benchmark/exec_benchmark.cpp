@@ -0,0 +1,89 @@
+#include "benchmark.hpp"
+
+#include <appbase/execution_priority_queue.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace appbase;
+
+namespace {
+
+   struct batch_config {
+      size_t   max_handlers;
+      uint32_t max_time_us;
+   };
+
+   /**
+    * Run the application::exec() loop over a backlog of cheap priority::low handlers while another thread posts
+    * priority::high probes through the ingress. Reports low handler throughput and the p50/p99 time a probe
+    * waited between add_concurrent() and its execution.
+    */
+   void run_exec_batch(const batch_config& cfg) {
+      constexpr size_t backlog = 200000;
+      constexpr size_t probes = 200;
+
+      boost::asio::io_service ios;
+      execution_priority_queue pri_queue;
+      size_t executed = 0;
+      std::vector<double> probe_latency_us;
+      probe_latency_us.reserve(probes);
+
+      for( size_t n = 0; n < backlog; ++n ) {
+         pri_queue.add(priority::low, [&executed]() {
+            std::atomic<int> spins{0}; // not a volatile, ++ on one is deprecated in C++20
+            while( spins.fetch_add(1, std::memory_order_relaxed) < 20 ) {}
+            ++executed;
+         });
+      }
+
+      std::atomic<bool> done{false};
+      std::thread prober([&]() {
+         for( size_t n = 0; n < probes && !done; ++n ) {
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+            auto posted = bench::clock::now();
+            if( pri_queue.add_concurrent(priority::high, [&, posted]() {
+                  probe_latency_us.push_back(std::chrono::duration<double, std::micro>(bench::clock::now() - posted).count());
+               }) ) {
+               boost::asio::post(ios, [&]() { pri_queue.drain_ingress(); });
+            }
+         }
+      });
+
+      auto start = bench::clock::now();
+      double elapsed = 0;
+      {
+         boost::asio::io_service::work work(ios);
+         bool more = true;
+         while( more || ios.run_one() ) {
+            while( ios.poll_one() ) {}
+            more = pri_queue.execute_batch(cfg.max_handlers, std::chrono::microseconds(cfg.max_time_us));
+            if( executed == backlog && elapsed == 0 ) {
+               elapsed = bench::seconds_since(start);
+               done = true;
+               ios.stop();
+            }
+         }
+      }
+      prober.join();
+
+      std::string params = "batch=" + std::to_string(cfg.max_handlers) + " time_us=" + std::to_string(cfg.max_time_us);
+      bench::report("exec_batch_throughput", params, backlog / elapsed, "handlers/s");
+      if( !probe_latency_us.empty() ) {
+         std::sort(probe_latency_us.begin(), probe_latency_us.end());
+         bench::report("exec_batch_high_latency", params + " pct=50", probe_latency_us[probe_latency_us.size() / 2], "us");
+         bench::report("exec_batch_high_latency", params + " pct=99", probe_latency_us[probe_latency_us.size() * 99 / 100], "us");
+      }
+   }
+
+   void exec_batch() {
+      for( const batch_config& cfg : std::vector<batch_config>{ {1, 0}, {16, 0}, {256, 0}, {256, 50}, {4096, 100} } )
+         run_exec_batch(cfg);
+   }
+
+} // namespace
+
+APPBASE_BENCHMARK("exec_batch", exec_batch);
@@ -0,0 +1,150 @@
+#include "benchmark.hpp"
+
+#include <boost/version.hpp>
+
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+namespace appbase { namespace bench {
+
+   volatile uint64_t optimization_sink = 0;
+
+   namespace {
+      struct result {
+         std::string name;
+         std::string params;
+         double      value;
+         std::string unit;
+      };
+
+      bool                 json_output = false;
+      std::vector<result>  results;
+
+      void write_json_string(std::ostream& os, const std::string& s) {
+         os << '"';
+         for( char c : s ) {
+            if( c == '"' || c == '\\' )
+               os << '\\' << c;
+            else if( static_cast<unsigned char>(c) < 0x20 )
+               os << ' ';
+            else
+               os << c;
+         }
+         os << '"';
+      }
+
+      void write_json_number(std::ostream& os, double v) {
+         if( !std::isfinite(v) ) {
+            os << "null";
+            return;
+         }
+         char buf[32];
+         std::snprintf(buf, sizeof(buf), "%.6g", v);
+         os << buf;
+      }
+
+      /// params are space separated key=value pairs, written as a JSON object of strings
+      void write_json_params(std::ostream& os, const std::string& params) {
+         std::istringstream in(params);
+         std::string token;
+         bool first = true;
+         os << '{';
+         while( in >> token ) {
+            const auto eq = token.find('=');
+            os << (first ? "" : ",");
+            write_json_string(os, token.substr(0, eq));
+            os << ':';
+            write_json_string(os, eq == std::string::npos ? std::string() : token.substr(eq + 1));
+            first = false;
+         }
+         os << '}';
+      }
+
+      /**
+       * All results as one JSON document, with enough about the build and host to tell runs apart
+       */
+      void write_json(std::ostream& os) {
+         os << "{\n  \"context\": {\"compiler\": ";
+         write_json_string(os, __VERSION__);
+         os << ", \"boost\": " << BOOST_VERSION
+#ifdef NDEBUG
+            << ", \"assertions\": false"
+#else
+            << ", \"assertions\": true"
+#endif
+            << ", \"hardware_threads\": " << std::thread::hardware_concurrency()
+            << ", \"timestamp\": " << std::time(nullptr) << "},\n  \"results\": [";
+         for( size_t i = 0; i < results.size(); ++i ) {
+            const result& r = results[i];
+            os << (i ? ",\n" : "\n") << "    {\"benchmark\": ";
+            write_json_string(os, r.name);
+            os << ", \"params\": ";
+            write_json_params(os, r.params);
+            os << ", \"value\": ";
+            write_json_number(os, r.value);
+            os << ", \"unit\": ";
+            write_json_string(os, r.unit);
+            os << '}';
+         }
+         os << "\n  ]\n}\n";
+      }
+   }
+
+   std::vector<benchmark>& registry() {
+      static std::vector<benchmark> benchmarks;
+      return benchmarks;
+   }
+
+   void report(const std::string& name, const std::string& params, double value, const std::string& unit) {
+      if( json_output ) {
+         results.push_back({name, params, value, unit});
+         // progress on stderr, so that stdout is only the JSON document
+         std::cerr << name << " " << params << " " << value << " " << unit << std::endl;
+      } else {
+         std::cout << name << " " << params << " " << value << " " << unit << std::endl;
+      }
+   }
+
+} } // appbase::bench
+
+/**
+ * Usage: appbase_bench [--json] [--list] [filter...]
+ *
+ * Runs every registered benchmark whose name contains one of the filters, or all of them if no filter is given.
+ * Each measurement is reported as one line: <benchmark> <key=value params> <value> <unit>. With --json the results
+ * are written to stdout as one JSON document instead, for comparing runs between releases.
+ * --list prints the names of the selected benchmarks without running them.
+ */
+int main( int argc, char** argv ) {
+   std::vector<std::string> filters;
+   bool list = false;
+   for( int i = 1; i < argc; ++i ) {
+      const std::string arg = argv[i];
+      if( arg == "--json" )
+         appbase::bench::json_output = true;
+      else if( arg == "--list" )
+         list = true;
+      else
+         filters.push_back(arg);
+   }
+
+   for( const auto& b : appbase::bench::registry() ) {
+      bool selected = filters.empty();
+      for( size_t i = 0; i < filters.size() && !selected; ++i )
+         selected = b.name.find(filters[i]) != std::string::npos;
+      if( !selected )
+         continue;
+      if( list )
+         std::cout << b.name << std::endl;
+      else
+         b.run();
+   }
+
+   if( appbase::bench::json_output && !list )
+      appbase::bench::write_json(std::cout);
+   return 0;
+}
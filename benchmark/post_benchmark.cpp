@@ -0,0 +1,247 @@
+#include "benchmark.hpp"
+
+#include <appbase/application.hpp>
+#include <appbase/execution_priority_queue.hpp>
+
+#include <boost/asio/steady_timer.hpp>
+
+#include <array>
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace appbase;
+
+namespace {
+
+   constexpr size_t posts_per_producer = 20000;
+
+   enum class post_path { io_service, ingress };
+
+   /**
+    * Measure posts/sec with num_producers threads posting into one consumer thread that runs the same
+    * loop as application::exec(). The io_service path is the pre-ingress application::post, the ingress path
+    * is execution_priority_queue::add_concurrent with an io_service wake-up only on empty -> non-empty.
+    */
+   double run_post_throughput(post_path path, size_t num_producers) {
+      boost::asio::io_service ios;
+      execution_priority_queue pri_queue;
+      const size_t total = num_producers * posts_per_producer;
+      size_t executed = 0;
+
+      auto handler = [&]() {
+         if( ++executed == total )
+            ios.stop();
+      };
+
+      std::atomic<bool> go{false};
+      std::vector<std::thread> producers;
+      for( size_t i = 0; i < num_producers; ++i ) {
+         producers.emplace_back([&, i]() {
+            while( !go.load() ) std::this_thread::yield();
+            const int prio = i % 2 ? priority::high : priority::medium;
+            for( size_t n = 0; n < posts_per_producer; ++n ) {
+               if( path == post_path::io_service ) {
+                  auto h = handler;
+                  boost::asio::post(ios, pri_queue.wrap(prio, std::move(h)));
+               } else if( pri_queue.add_concurrent(prio, handler) ) {
+                  boost::asio::post(ios, [&]() { pri_queue.drain_ingress(); });
+               }
+            }
+         });
+      }
+
+      auto start = bench::clock::now();
+      go = true;
+      {
+         boost::asio::io_service::work work(ios);
+         bool more = true;
+         while( more || ios.run_one() ) {
+            while( ios.poll_one() ) {}
+            more = pri_queue.execute_highest();
+         }
+      }
+      double elapsed = bench::seconds_since(start);
+
+      for( auto& t : producers )
+         t.join();
+      return total / elapsed;
+   }
+
+   void post_throughput() {
+      for( size_t producers : {1, 2, 4, 8, 12} ) {
+         for( post_path path : {post_path::io_service, post_path::ingress} ) {
+            std::string params = std::string("path=") + (path == post_path::io_service ? "io_service" : "ingress") +
+                                 " producers=" + std::to_string(producers);
+            bench::report("post_throughput", params, run_post_throughput(path, producers), "posts/s");
+         }
+      }
+   }
+
+   /**
+    * Steady state heap allocations per post: warm the queue up with one burst, then measure
+    * execution_priority_queue::heap_allocations() over further bursts of the same size.
+    */
+   void post_allocations() {
+      constexpr size_t burst = 1000;
+      constexpr size_t bursts = 100;
+      execution_priority_queue pri_queue;
+      size_t executed = 0;
+      auto run_burst = [&]() {
+         for( size_t n = 0; n < burst; ++n )
+            pri_queue.add_concurrent(n % 2 ? priority::high : priority::low, [&executed]() { ++executed; });
+         pri_queue.drain_ingress();
+         pri_queue.execute_all();
+      };
+
+      run_burst();
+      const uint64_t warm = pri_queue.heap_allocations();
+      for( size_t i = 0; i < bursts; ++i )
+         run_burst();
+      const double per_post = double(pri_queue.heap_allocations() - warm) / (burst * bursts);
+      bench::report("post_allocations", "burst=" + std::to_string(burst), per_post, "allocs/post");
+   }
+
+   /**
+    * Measure posts/sec through application::post with num_producers threads and handlers capturing Size bytes,
+    * executed by the calling thread in the same loop as application::exec(). Handlers larger than
+    * impl::handler_function::inline_size are heap allocated.
+    */
+   template<size_t Size>
+   double run_app_post(size_t num_producers) {
+      auto& ios = app().get_io_service();
+      const size_t total = num_producers * posts_per_producer;
+      size_t executed = 0;
+      std::array<char, Size> capture{};
+
+      std::atomic<bool> go{false};
+      std::vector<std::thread> producers;
+      for( size_t i = 0; i < num_producers; ++i ) {
+         producers.emplace_back([&, i]() {
+            while( !go.load() ) std::this_thread::yield();
+            const int prio = i % 2 ? priority::high : priority::medium;
+            for( size_t n = 0; n < posts_per_producer; ++n ) {
+               app().post(prio, [&, capture]() {
+                  executed += capture[0] + 1;
+                  if( executed == total )
+                     app().get_io_service().stop();
+               });
+            }
+         });
+      }
+
+      ios.restart();
+      auto start = bench::clock::now();
+      go = true;
+      {
+         boost::asio::io_service::work work(ios);
+         bool more = true;
+         while( more || ios.run_one() ) {
+            while( ios.poll_one() ) {}
+            more = app().get_priority_queue().execute_highest();
+         }
+      }
+      double elapsed = bench::seconds_since(start);
+
+      for( auto& t : producers )
+         t.join();
+      return total / elapsed;
+   }
+
+   void app_post() {
+      for( size_t producers : {1, 2, 4} ) {
+         bench::report("app_post", "producers=" + std::to_string(producers) + " capture=8", run_app_post<8>(producers), "posts/s");
+         bench::report("app_post", "producers=" + std::to_string(producers) + " capture=128", run_app_post<128>(producers), "posts/s");
+      }
+   }
+
+   /**
+    * Throughput of a thread_pool with a number of threads running cheap handlers, half posted from outside
+    * the pool and half spawned by the handlers themselves, which go to the spawning thread's queue
+    */
+   void background_pool() {
+      constexpr size_t roots = 50000;
+      for( size_t threads : {1, 2, 4} ) {
+         thread_pool pool;
+         pool.configure(threads, false);
+         std::atomic<size_t> executed{0};
+         std::atomic<bool> finished{false};
+         auto work = [&]() {
+            std::atomic<int> spins{0}; // not a volatile, ++ on one is deprecated in C++20
+            while( spins.fetch_add(1, std::memory_order_relaxed) < 50 ) {}
+            if( executed.fetch_add(1) + 1 == 2 * roots )
+               finished = true;
+         };
+
+         auto start = bench::clock::now();
+         for( size_t n = 0; n < roots; ++n ) {
+            pool.post(n % 2 ? priority::high : priority::low, [&]() {
+               work();
+               pool.post(priority::medium, work);
+            });
+         }
+         while( !finished.load() )
+            std::this_thread::yield();
+         double elapsed = bench::seconds_since(start);
+         bench::report("background_pool", "threads=" + std::to_string(threads), 2 * roots / elapsed, "handlers/s");
+         bench::report("background_pool", "threads=" + std::to_string(threads) + " stat=steals", double(pool.steals()), "handlers");
+      }
+   }
+
+   /**
+    * Steady state heap allocations and rate of asio completions run on the queue through pri_queue.wrap, by a
+    * steady_timer re-armed from its handler. The handler captures Size bytes, so with 128 it is too large to be
+    * stored inline and is boxed in the queue's recycling arena.
+    */
+   template<size_t Size>
+   void run_wrapped_completions() {
+      constexpr size_t warmup = 100;
+      constexpr size_t completions = 100000;
+      boost::asio::io_service ios;
+      execution_priority_queue pri_queue;
+      boost::asio::steady_timer timer(ios);
+      std::array<char, Size> capture{};
+      size_t executed = 0;
+      uint64_t warm = 0;
+      bench::clock::time_point start;
+
+      std::function<void()> arm = [&]() {
+         timer.expires_at(boost::asio::steady_timer::clock_type::time_point::min());
+         timer.async_wait(pri_queue.wrap(priority::medium, [&, capture](const boost::system::error_code&) {
+            executed += capture[0] + 1;
+            if( executed == warmup ) {
+               warm = pri_queue.heap_allocations();
+               start = bench::clock::now();
+            }
+            if( executed < warmup + completions )
+               arm();
+         }));
+      };
+      arm();
+      {
+         boost::asio::io_service::work work(ios);
+         while( executed < warmup + completions && ios.run_one() ) {
+            while( pri_queue.execute_highest() ) {}
+         }
+      }
+      const double elapsed = bench::seconds_since(start);
+      const std::string params = "capture=" + std::to_string(Size);
+      bench::report("wrapped_completions", params, completions / elapsed, "completions/s");
+      bench::report("wrapped_completions", params + " stat=allocations",
+                    double(pri_queue.heap_allocations() - warm) / completions, "allocs/completion");
+   }
+
+   void wrapped_completions() {
+      run_wrapped_completions<8>();
+      run_wrapped_completions<128>();
+   }
+
+} // namespace
+
+APPBASE_BENCHMARK("post_throughput", post_throughput);
+APPBASE_BENCHMARK("post_allocations", post_allocations);
+APPBASE_BENCHMARK("app_post", app_post);
+APPBASE_BENCHMARK("background_pool", background_pool);
+APPBASE_BENCHMARK("wrapped_completions", wrapped_completions);
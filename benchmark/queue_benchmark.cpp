@@ -0,0 +1,130 @@
+#include "benchmark.hpp"
+
+#include <appbase/execution_priority_queue.hpp>
+
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <vector>
+
+using namespace appbase;
+
+namespace {
+
+   const char* to_string(execution_priority_queue::scheduling s) {
+      switch( s ) {
+         case execution_priority_queue::scheduling::bucketed:      return "bucketed";
+         case execution_priority_queue::scheduling::bucketed_fair: return "bucketed_fair";
+         default:                                                  return "binary_heap";
+      }
+   }
+
+   /**
+    * add() a burst of handlers spread over 1, 2 or all 7 of the appbase::priority constants, then execute them all.
+    * Reports handlers/sec for add + execute.
+    */
+   void queue_add_execute() {
+      const std::vector<std::vector<int>> mixes = {
+         { priority::medium },
+         { priority::high, priority::low },
+         { priority::lowest, priority::low, priority::medium_low, priority::medium, priority::medium_high, priority::high, priority::highest }
+      };
+      constexpr size_t rounds = 20;
+      for( const auto& priorities : mixes ) {
+         for( size_t burst : {100, 10000, 100000} ) {
+            for( auto s : {execution_priority_queue::scheduling::binary_heap, execution_priority_queue::scheduling::bucketed} ) {
+               execution_priority_queue pri_queue;
+               pri_queue.set_scheduling(s);
+               size_t executed = 0;
+               auto start = bench::clock::now();
+               for( size_t r = 0; r < rounds; ++r ) {
+                  for( size_t n = 0; n < burst; ++n )
+                     pri_queue.add(priorities[n % priorities.size()], [&executed]() { ++executed; });
+                  pri_queue.execute_all();
+               }
+               double elapsed = bench::seconds_since(start);
+               bench::report("queue_add_execute", std::string("scheduling=") + to_string(s) + " burst=" + std::to_string(burst) +
+                             " priorities=" + std::to_string(priorities.size()), executed / elapsed, "handlers/s");
+            }
+         }
+      }
+   }
+
+   /**
+    * Cost of execution_priority_queue::set_metrics_enabled() on add + execute of small handlers
+    */
+   void queue_metrics_overhead() {
+      constexpr size_t burst = 10000;
+      constexpr size_t rounds = 20;
+      for( bool enabled : {false, true} ) {
+         execution_priority_queue pri_queue;
+         pri_queue.set_metrics_enabled(enabled);
+         size_t executed = 0;
+         auto start = bench::clock::now();
+         for( size_t r = 0; r < rounds; ++r ) {
+            for( size_t n = 0; n < burst; ++n )
+               pri_queue.add(n % 2 ? priority::high : priority::low, APPBASE_HERE, [&executed]() { ++executed; });
+            pri_queue.execute_all();
+         }
+         double elapsed = bench::seconds_since(start);
+         bench::report("queue_metrics_overhead", std::string("metrics=") + (enabled ? "on" : "off"), elapsed * 1e9 / executed, "ns/handler");
+      }
+   }
+
+   /**
+    * Sustained priority::high load, in_flight handlers that each add a new one when they run, over a backlog of
+    * priority::low handlers. Reports low handlers/sec and the p50/p99 time a high handler waited in the queue.
+    */
+   void run_queue_mixed_load(execution_priority_queue::scheduling s, uint32_t starvation_limit) {
+      constexpr size_t in_flight = 64;
+      constexpr size_t backlog = 100000;
+      constexpr size_t executions = 400000;
+
+      execution_priority_queue pri_queue;
+      pri_queue.set_scheduling(s);
+      pri_queue.set_starvation_limit(starvation_limit);
+      size_t low_executed = 0;
+      size_t high_executed = 0;
+      std::vector<double> high_wait_us;
+      high_wait_us.reserve(executions);
+
+      for( size_t n = 0; n < backlog; ++n )
+         pri_queue.add(priority::low, [&low_executed]() { ++low_executed; });
+
+      std::function<void()> add_high = [&]() {
+         auto added = bench::clock::now();
+         pri_queue.add(priority::high, [&, added]() {
+            high_wait_us.push_back(std::chrono::duration<double, std::micro>(bench::clock::now() - added).count());
+            ++high_executed;
+            add_high();
+         });
+      };
+      for( size_t n = 0; n < in_flight; ++n )
+         add_high();
+
+      auto start = bench::clock::now();
+      for( size_t n = 0; n < executions; ++n )
+         pri_queue.execute_highest();
+      double elapsed = bench::seconds_since(start);
+
+      std::sort(high_wait_us.begin(), high_wait_us.end());
+      std::string params = std::string("scheduling=") + to_string(s);
+      if( s == execution_priority_queue::scheduling::bucketed_fair )
+         params += " starvation_limit=" + std::to_string(starvation_limit);
+      bench::report("queue_mixed_load", params + " band=low", low_executed / elapsed, "handlers/s");
+      bench::report("queue_mixed_load", params + " band=high", high_executed / elapsed, "handlers/s");
+      bench::report("queue_mixed_load", params + " band=high pct=50", high_wait_us[high_wait_us.size() / 2], "us");
+      bench::report("queue_mixed_load", params + " band=high pct=99", high_wait_us[high_wait_us.size() * 99 / 100], "us");
+   }
+
+   void queue_mixed_load() {
+      run_queue_mixed_load(execution_priority_queue::scheduling::bucketed, 0);
+      for( uint32_t limit : {4, 16, 64} )
+         run_queue_mixed_load(execution_priority_queue::scheduling::bucketed_fair, limit);
+   }
+
+} // namespace
+
+APPBASE_BENCHMARK("queue_add_execute", queue_add_execute);
+APPBASE_BENCHMARK("queue_metrics_overhead", queue_metrics_overhead);
+APPBASE_BENCHMARK("queue_mixed_load", queue_mixed_load);
@@ -0,0 +1,52 @@
+#include "benchmark.hpp"
+
+#include <appbase/shm_channel.hpp>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace appbase;
+
+namespace {
+
+   /**
+    * Throughput of the shared memory ring of shm_channel_writer / shm_channel_reader, one producer thread
+    * pushing messages of a payload size and the benchmark thread popping them, in one process
+    */
+   void shm_ring_throughput() {
+      constexpr size_t messages = 1000000;
+      for( size_t payload : {8, 64, 256} ) {
+         const std::string name = "appbase.bench.shm_ring";
+         boost::interprocess::shared_memory_object::remove(name.c_str());
+         impl::shm_ring producer_ring(name, 4096, payload);
+         impl::shm_ring consumer_ring(name, 4096, payload);
+         std::vector<char> message(payload, 'x');
+
+         auto start = bench::clock::now();
+         std::thread producer([&]() {
+            for( size_t n = 0; n < messages; ++n ) {
+               while( !producer_ring.push(payload, [&](char* out) { std::memcpy(out, message.data(), payload); }) )
+                  std::this_thread::yield();
+            }
+         });
+         size_t received = 0;
+         uint64_t checksum = 0;
+         while( received < messages ) {
+            if( !consumer_ring.pop([&](const char* in, size_t size) { checksum += size_t(in[0]) + size; }) ) {
+               std::this_thread::yield();
+               continue;
+            }
+            ++received;
+         }
+         producer.join();
+         double elapsed = bench::seconds_since(start);
+         bench::do_not_optimize(checksum);
+         bench::report("shm_ring_throughput", "payload=" + std::to_string(payload), messages / elapsed, "msgs/s");
+         boost::interprocess::shared_memory_object::remove(name.c_str());
+      }
+   }
+
+} // namespace
+
+APPBASE_BENCHMARK("shm_ring_throughput", shm_ring_throughput);
@@ -0,0 +1,97 @@
+#include "benchmark.hpp"
+
+#include <appbase/timer_wheel.hpp>
+
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace appbase;
+
+namespace {
+
+   /// deadlines spread uniformly over the next 10 seconds, the same for every implementation
+   std::vector<std::chrono::milliseconds> random_delays(size_t count) {
+      std::mt19937 rng(42);
+      std::uniform_int_distribution<int> dist(1, 10000);
+      std::vector<std::chrono::milliseconds> delays(count);
+      for( auto& d : delays )
+         d = std::chrono::milliseconds(dist(rng));
+      return delays;
+   }
+
+   /**
+    * Schedule a number of pending timeouts into a timer_wheel and into one boost::asio::steady_timer each,
+    * the alternative without the wheel. Reports timers/s for scheduling, and for the wheel also for firing
+    * them all by advancing a simulated clock past the last deadline.
+    */
+   void timer_schedule() {
+      for( size_t pending : {1000, 100000, 500000} ) {
+         const auto delays = random_delays(pending);
+         const auto now = bench::clock::now();
+         size_t fired = 0;
+         {
+            timer_wheel wheel(std::chrono::milliseconds(1), now);
+            auto start = bench::clock::now();
+            for( const auto& d : delays )
+               wheel.add(now + d, priority::medium, impl::handler_function([&fired]() { ++fired; }));
+            double elapsed = bench::seconds_since(start);
+            bench::report("timer_schedule", "impl=timer_wheel pending=" + std::to_string(pending), pending / elapsed, "timers/s");
+
+            start = bench::clock::now();
+            wheel.advance(now + std::chrono::seconds(11), [](int, impl::handler_function&& f) { f(); });
+            elapsed = bench::seconds_since(start);
+            bench::report("timer_fire", "impl=timer_wheel pending=" + std::to_string(pending), pending / elapsed, "timers/s");
+         }
+         {
+            boost::asio::io_service ios;
+            std::vector<std::unique_ptr<boost::asio::steady_timer>> timers;
+            timers.reserve(pending);
+            auto start = bench::clock::now();
+            for( const auto& d : delays ) {
+               timers.emplace_back(std::make_unique<boost::asio::steady_timer>(ios, now + d));
+               timers.back()->async_wait([&fired](const boost::system::error_code&) { ++fired; });
+            }
+            double elapsed = bench::seconds_since(start);
+            bench::report("timer_schedule", "impl=steady_timer pending=" + std::to_string(pending), pending / elapsed, "timers/s");
+            for( auto& t : timers )
+               t->cancel();
+            ios.poll();
+         }
+         bench::do_not_optimize(fired);
+      }
+   }
+
+   /**
+    * Add a short timer to a wheel that has been idle for a number of days, either empty or with a single timer
+    * far in the future pending, and advance it past the new deadline. Reports the time of the add and advance.
+    */
+   void timer_idle() {
+      for( int days : {1, 10} ) {
+         for( bool pending : {false, true} ) {
+            const auto now = bench::clock::now();
+            timer_wheel wheel(std::chrono::milliseconds(1), now - std::chrono::hours(24 * days));
+            size_t fired = 0;
+            if( pending ) {
+               wheel.add(now - std::chrono::hours(24 * days) + std::chrono::hours(24 * 30), priority::medium,
+                         impl::handler_function([&fired]() { ++fired; }));
+            }
+            auto start = bench::clock::now();
+            wheel.add(now + std::chrono::milliseconds(5), priority::medium, impl::handler_function([&fired]() { ++fired; }));
+            wheel.advance(now + std::chrono::milliseconds(10), [](int, impl::handler_function&& f) { f(); });
+            double elapsed = bench::seconds_since(start);
+            bench::report("timer_idle", "days=" + std::to_string(days) + " pending=" + std::to_string(pending),
+                          elapsed * 1e6, "us");
+            bench::do_not_optimize(fired);
+         }
+      }
+   }
+
+}
+
+APPBASE_BENCHMARK("timer_schedule", timer_schedule);
+APPBASE_BENCHMARK("timer_idle", timer_idle);
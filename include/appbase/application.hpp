@@ -3,8 +3,16 @@
 #include <appbase/channel.hpp>
 #include <appbase/method.hpp>
 #include <appbase/execution_priority_queue.hpp>
+#include <appbase/strand.hpp>
+#include <appbase/trace.hpp>
+#include <appbase/timer_wheel.hpp>
+#include <appbase/thread_pool.hpp>
+#include <appbase/thread_placement.hpp>
+#include <appbase/coroutine.hpp>
 #include <boost/filesystem/path.hpp>
 #include <boost/core/demangle.hpp>
+#include <chrono>
+#include <mutex>
 #include <typeindex>
 
 namespace appbase {
@@ -13,6 +21,57 @@ namespace appbase {
 
    using config_comparison_f = std::function<bool(const boost::any& a, const boost::any& b)>;
 
+   namespace impl {
+      /// demangled name of T, demangled once
+      template<typename T>
+      const string& demangled_name() {
+         static const string name = boost::core::demangle(typeid(T).name());
+         return name;
+      }
+   }
+
+   /**
+    * Time a plugin spent in each lifecycle step, excluding the plugins it requires
+    */
+   struct plugin_profile {
+      string                    name;
+      std::chrono::microseconds initialize{0};
+      std::chrono::microseconds startup{0};
+      std::chrono::microseconds shutdown{0};
+   };
+
+   /**
+    * Wall clock time of each application lifecycle phase and of every plugin within them
+    */
+   struct lifecycle_profile {
+      std::chrono::microseconds options{0};     ///< parsing the command line and config file
+      std::chrono::microseconds initialize{0};  ///< initializing plugins
+      std::chrono::microseconds startup{0};     ///< starting plugins
+      std::chrono::microseconds shutdown{0};    ///< shutting down plugins
+      vector<plugin_profile>    plugins;        ///< in the order the plugins were first initialized
+   };
+
+   /**
+    * The chain of dependent plugins that bounds how fast plugin initialize, startup or shutdown can complete, no
+    * matter how many plugin-init-threads or shutdown-threads run them
+    */
+   struct plugin_critical_path {
+      std::chrono::microseconds length{0};  ///< sum of the durations of the plugins on the path
+      std::chrono::microseconds total{0};   ///< sum of the durations of all plugins
+      vector<string>            plugins;    ///< the plugins on the path, dependencies first
+   };
+
+   /**
+    * How long exec() took to notice posted handlers, see application::get_wakeup_statistics()
+    */
+   struct wakeup_statistics {
+      uint64_t                  wakeups = 0;       ///< posts that found the ingress of the queue empty
+      uint64_t                  spin_wakeups = 0;  ///< of those, noticed while exec() was spinning
+      std::chrono::nanoseconds  total_latency{0};  ///< time from the post until exec() drained it
+      std::chrono::nanoseconds  max_latency{0};
+      queue_metrics::histogram  latency_ns{};      ///< latencies in nanoseconds
+   };
+
    class application
    {
       public:
@@ -80,14 +139,30 @@ namespace appbase {
          bfs::path full_config_file_path() const;
          /** @brief Set function pointer invoked on receipt of SIGHUP
           *
-          * The provided function will be invoked on receipt of SIGHUP followed
-          * by invoking handle_sighup() on all initialized plugins. Caller
-          * is responsible for preserving an object if necessary.
+          * The provided function will be invoked on receipt of SIGHUP, after the
+          * config file has been reloaded with reload_config(), followed by invoking
+          * handle_sighup() on all initialized plugins. Caller is responsible for
+          * preserving an object if necessary.
           *
           * @param callback Function pointer that will be invoked when the process
           *                 receives the HUP (1) signal.
           */
           void set_sighup_callback(std::function<void()> callback);
+
+         /**
+          * Parse the config file again and apply the options whose value changed, as done on receipt of SIGHUP.
+          * Only call from the thread running exec(), and not while handlers on other exec(num_threads) threads
+          * may read get_options().
+          *
+          * Values are compared with the comparators of register_config_type(). Each changed option is stored in
+          * get_options() and its notifier runs, then every initialized plugin that declared changed options gets
+          * them, and only them, in handle_config_changed(). An option also given on the command line keeps its
+          * command line value, an option removed from the config file reverts to its default. Changed application
+          * options are stored but only take effect on restart. If the file cannot be parsed nothing is changed.
+          *
+          * @return the names of the changed options
+          */
+         vector<string> reload_config();
          /**
           * @brief Looks for the --plugin commandline / config option and calls initialize on those plugins
           *
@@ -102,11 +177,51 @@ namespace appbase {
 
          void                  startup();
 
+         /**
+          * @return the critical path of the plugin initialize run by initialize()
+          */
+         const plugin_critical_path& initialize_critical_path() const;
+
+         /**
+          * @return the critical path of the plugin startup run by startup()
+          */
+         const plugin_critical_path& startup_critical_path() const;
+
+         /**
+          * @return the critical path of the plugin shutdown run by shutdown(), plugins listed in shutdown order
+          */
+         const plugin_critical_path& shutdown_critical_path() const;
+
+         /**
+          * @return the time spent in each lifecycle phase and by each plugin so far
+          */
+         const lifecycle_profile& get_lifecycle_profile() const;
+
+         /**
+          * Print the lifecycle profile as a table, the --print-startup-profile option prints it to std::cerr
+          * after startup() and again after shutdown
+          */
+         void print_lifecycle_profile(std::ostream& os) const;
+
+         /**
+          * @return how long exec() took to notice posted handlers, which with the default exec-idle-strategy
+          *         block includes waking the thread blocked in the io_service
+          */
+         wakeup_statistics get_wakeup_statistics() const;
+
+         /// print get_wakeup_statistics(), the --print-wakeup-statistics option prints them to std::cerr when exec() returns
+         void print_wakeup_statistics(std::ostream& os) const;
+
          /**
           *  Wait until quit(), SIGINT or SIGTERM and then shutdown.
           *  Should only be executed from one thread.
+          *
+          *  @param num_threads number of threads executing posted handlers. The calling thread runs the io_service
+          *         and handlers; any additional threads only execute handlers from the priority queue, always taking
+          *         the highest priority one available. With more than one thread, handlers that must not run
+          *         concurrently need to be posted through a @ref strand.
           */
-         void                 exec();
+         void                 exec(size_t num_threads = 1);
          void                 quit();
 
          /**
@@ -133,20 +248,29 @@ namespace appbase {
 
          template<typename Plugin>
          auto& register_plugin() {
+            auto lock = registry_lock();
             auto existing = find_plugin<Plugin>();
             if(existing)
                return *existing;
 
             auto plug = new Plugin();
             plugins[plug->name()].reset(plug);
+            cache_plugin(decl_slot<Plugin>(), plug);
             plug->register_dependencies();
             return *plug;
          }
 
+         /**
+          * A plugin registered with register_plugin() is resolved through a fixed per-type slot, so the lookup
+          * is a single indexed load; other plugin types are looked up by name.
+          */
          template<typename Plugin>
          Plugin* find_plugin()const {
-            string name = boost::core::demangle(typeid(Plugin).name());
-            return dynamic_cast<Plugin*>(find_plugin(name));
+            auto lock = registry_lock();
+            const size_t slot = decl_slot<Plugin>();
+            if( slot < plugin_cache.size() && plugin_cache[slot] )
+               return static_cast<Plugin*>(plugin_cache[slot]);
+            return dynamic_cast<Plugin*>(find_plugin(impl::demangled_name<Plugin>()));
          }
 
          template<typename Plugin>
@@ -159,6 +283,9 @@ namespace appbase {
           * Fetch a reference to the method declared by the passed in type.  This will construct the method
           * on first access.  This allows loose and deferred binding between plugins
           *
+          * After the first access the method is resolved through a fixed per-declaration slot, so repeated
+          * calls are a single indexed load.
+          *
           * @tparam MethodDecl - @ref appbase::method_decl
           * @return reference to the method described by the declaration
           */
@@ -166,20 +293,27 @@ namespace appbase {
          auto get_method() -> std::enable_if_t<is_method_decl<MethodDecl>::value, typename MethodDecl::method_type&>
          {
             using method_type = typename MethodDecl::method_type;
+            auto lock = registry_lock();
+            const size_t slot = decl_slot<MethodDecl>();
+            if( slot < decl_cache.size() && decl_cache[slot] )
+               return *static_cast<method_type*>(decl_cache[slot]);
+
             auto key = std::type_index(typeid(MethodDecl));
             auto itr = methods.find(key);
-            if(itr != methods.end()) {
-               return *method_type::get_method(itr->second);
-            } else {
-               methods.emplace(std::make_pair(key, method_type::make_unique()));
-               return  *method_type::get_method(methods.at(key));
-            }
+            if(itr == methods.end())
+               itr = methods.emplace(std::make_pair(key, method_type::make_unique())).first;
+            method_type* m = method_type::get_method(itr->second);
+            cache_decl(slot, m);
+            return *m;
          }
 
          /**
           * Fetch a reference to the channel declared by the passed in type.  This will construct the channel
           * on first access.  This allows loose and deferred binding between plugins
           *
+          * After the first access the channel is resolved through a fixed per-declaration slot, so repeated
+          * calls are a single indexed load.
+          *
           * @tparam ChannelDecl - @ref appbase::channel_decl
           * @return reference to the channel described by the declaration
           */
@@ -187,34 +321,113 @@ namespace appbase {
          auto get_channel() -> std::enable_if_t<is_channel_decl<ChannelDecl>::value, typename ChannelDecl::channel_type&>
          {
             using channel_type = typename ChannelDecl::channel_type;
+            auto lock = registry_lock();
+            const size_t slot = decl_slot<ChannelDecl>();
+            if( slot < decl_cache.size() && decl_cache[slot] )
+               return *static_cast<channel_type*>(decl_cache[slot]);
+
             auto key = std::type_index(typeid(ChannelDecl));
             auto itr = channels.find(key);
-            if(itr != channels.end()) {
-               return *channel_type::get_channel(itr->second);
-            } else {
-               channels.emplace(std::make_pair(key, channel_type::make_unique()));
-               return  *channel_type::get_channel(channels.at(key));
-            }
+            if(itr == channels.end())
+               itr = channels.emplace(std::make_pair(key, channel_type::make_unique())).first;
+            channel_type* c = channel_type::get_channel(itr->second);
+            cache_decl(slot, c);
+            return *c;
          }
 
          /**
-          * Do not run io_service in any other threads, as application assumes single-threaded execution in exec().
+          * Do not run io_service in any other threads: exec() runs it on its calling thread only, even when exec(num_threads)
+          * runs queued handlers on additional threads.
           * @return io_serivice of application
           */
          boost::asio::io_service& get_io_service() { return *io_serv; }
 
          /**
-          * Post func to run on io_service with given priority.
+          * Post func to run with given priority. Safe to call from any thread.
+          *
+          * func is pushed onto the lock-free ingress of the priority queue; the io_service is only
+          * touched to wake exec() when the ingress transitions from empty to non-empty.
           *
           * @param priority can be appbase::priority::* constants or any int, larger ints run first
-          * @param func function to run on io_service
-          * @return result of boost::asio::post
+          * @param func function to run on the thread executing exec(); with exec(num_threads) it runs on any of
+          *        its threads, so handlers that must not run concurrently need to be posted through a @ref strand
+          */
+         template <typename Func>
+         void post( int priority, Func&& func ) {
+            post( priority, nullptr, std::forward<Func>(func) );
+         }
+
+         /**
+          * Post func tagged with its posting site, e.g. `app().post( priority::medium, APPBASE_HERE, lambda )`.
+          * The tag identifies the handler in the priority queue metrics.
+          */
+         template <typename Func>
+         void post( int priority, const char* tag, Func&& func ) {
+            if( pri_queue.add_concurrent(priority, tag, std::forward<Func>(func)) ) {
+               wake_requested.store(std::chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_release);
+               pri_queue.notify_idle_worker();
+               boost::asio::post(*io_serv, [this]() {
+                  // the queue may have drained the ingress on its own, or a spinning exec() did
+                  if( pri_queue.drain_pending() )
+                     record_wakeup(false);
+                  pri_queue.drain_ingress();
+               });
+            }
+         }
+
+         /**
+          * Post func to run with given priority once deadline is reached. Safe to call from any thread.
+          *
+          * Pending timers are kept in a timer wheel of 1 ms ticks owned by the application, which arms a single
+          * io_service timer for the earliest of them; expired handlers are added directly to the priority queue.
+          * Adding a timer is O(1) and does not allocate in steady state, so hundreds of thousands of pending
+          * timeouts are cheap. A handler never runs before its deadline, and runs within about a tick after it
+          * unless the queue is busy with higher priority work. Timers cannot be cancelled, pending timers are
+          * destroyed without running when exec() returns.
+          */
+         template <typename Func>
+         void post_at( std::chrono::steady_clock::time_point deadline, int priority, Func&& func ) {
+            schedule_timer( deadline, priority, impl::handler_function(std::forward<Func>(func)) );
+         }
+
+         /**
+          * Post func to run with given priority once delay has passed, see post_at()
+          */
+         template <typename Rep, typename Period, typename Func>
+         void post_after( std::chrono::duration<Rep, Period> delay, int priority, Func&& func ) {
+            post_at( std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(delay),
+                     priority, std::forward<Func>(func) );
+         }
+
+         /**
+          * Post func to run with given priority on the application's background thread pool instead of the thread
+          * running exec(), for work that plugins would otherwise run on their own threads. Safe to call from any thread.
+          *
+          * The pool has `background-threads` threads, by default one per core but one, started by the first call; see
+          * @ref thread_pool. A handler that throws makes exec() rethrow its exception. To hand a result back to the
+          * application queue, app().post() it from func: posting from a pool thread is lock-free.
           */
          template <typename Func>
-         auto post( int priority, Func&& func ) {
-            return boost::asio::post(*io_serv, pri_queue.wrap(priority, std::forward<Func>(func)));
+         void post_background( int priority, Func&& func ) {
+            bg_pool.post( priority, std::forward<Func>(func) );
          }
 
+         thread_pool& get_background_pool() {
+            return bg_pool;
+         }
+
+#ifdef APPBASE_HAS_COROUTINES
+         /**
+          * Awaitable that suspends the calling coroutine and resumes it from the priority queue with given
+          * priority, letting the handlers queued at a higher priority run first:
+          *   co_await app().yield( priority::low );
+          * The queue entry holds only the coroutine handle, so yielding does not allocate. See coroutine.hpp.
+          */
+         impl::yield_awaitable yield( int priority ) {
+            return impl::yield_awaitable{priority};
+         }
+#endif
+
          /**
           * Provide access to execution priority queue so it can be used to wrap functions for
           * prioritized execution.
@@ -227,6 +440,11 @@ namespace appbase {
             return pri_queue;
          }
 
+         /**
+          * Must not be read concurrently with reload_config(), which runs on the thread running exec() on SIGHUP.
+          * With exec(num_threads), handlers on the other threads should use values copied in plugin_initialize()
+          * or handle_config_changed() instead.
+          */
          const bpo::variables_map& get_options() const;
 
          /**
@@ -245,8 +463,14 @@ namespace appbase {
           * the application can call shutdown in the reverse order.
           */
          ///@{
-         void plugin_initialized(abstract_plugin& plug){ initialized_plugins.push_back(&plug); }
-         void plugin_started(abstract_plugin& plug){ running_plugins.push_back(&plug); }
+         void plugin_initialized(abstract_plugin& plug){
+            std::lock_guard<std::mutex> g(plugin_state_mtx);
+            initialized_plugins.push_back(&plug);
+         }
+         void plugin_started(abstract_plugin& plug){
+            std::lock_guard<std::mutex> g(plugin_state_mtx);
+            running_plugins.push_back(&plug);
+         }
          ///@}
 
       private:
@@ -254,15 +478,63 @@ namespace appbase {
          map<string, std::unique_ptr<abstract_plugin>> plugins; ///< all registered plugins
          vector<abstract_plugin*>                  initialized_plugins; ///< stored in the order they were started running
          vector<abstract_plugin*>                  running_plugins; ///< stored in the order they were started running
+         std::mutex                                plugin_state_mtx; ///< plugins may initialize / start on plugin-init-threads
 
          std::function<void()>                     sighup_callback;
          map<std::type_index, erased_method_ptr>   methods;
          map<std::type_index, erased_channel_ptr>  channels;
+         vector<void*>                             decl_cache; ///< method or channel by decl_slot(), owned by methods / channels
+         vector<void*>                             plugin_cache; ///< registered plugin by decl_slot() of its type, owned by plugins
+
+         static size_t next_decl_slot();
+
+         mutable std::recursive_mutex              registry_mtx; ///< guards the registries and slot caches above while concurrent_plugins
+         std::atomic<bool>                         concurrent_plugins{false}; ///< run_plugins() runs plugins on several threads
+
+         /// locks the plugin, method and channel registries, only while plugins run concurrently
+         std::unique_lock<std::recursive_mutex> registry_lock() const {
+            return concurrent_plugins.load(std::memory_order_acquire) ? std::unique_lock<std::recursive_mutex>(registry_mtx)
+                                                                       : std::unique_lock<std::recursive_mutex>();
+         }
+
+         std::atomic<int64_t>                      wake_requested{0}; ///< steady_clock time of the post that made the ingress non-empty
+
+         /// wait for io_service work or posted handlers according to exec-idle-strategy, false once stopped
+         bool wait_for_work();
+         void record_wakeup(bool spinning);
+
+         void schedule_timer(std::chrono::steady_clock::time_point deadline, int priority, impl::handler_function&& func);
+         void arm_timer(); ///< wait for the earliest pending timer, only on the io_service thread
+
+         /// fixed index of a method or channel declaration into decl_cache, or of a plugin type into plugin_cache,
+         /// handed out on first use
+         template<typename Decl>
+         static size_t decl_slot() {
+            static const size_t slot = next_decl_slot();
+            return slot;
+         }
+
+         void cache_decl(size_t slot, void* ptr) {
+            if( slot >= decl_cache.size() )
+               decl_cache.resize(slot + 1, nullptr);
+            decl_cache[slot] = ptr;
+         }
+
+         void cache_plugin(size_t slot, void* ptr) {
+            if( slot >= plugin_cache.size() )
+               plugin_cache.resize(slot + 1, nullptr);
+            plugin_cache[slot] = ptr;
+         }
 
          std::shared_ptr<boost::asio::io_service>  io_serv;
          execution_priority_queue                  pri_queue;
+         thread_pool                               bg_pool; ///< stopped by shutdown(), after the plugins
 
          void start_sighup_handler( std::shared_ptr<boost::asio::signal_set> sighup_set );
+         void start_sigusr1_handler( std::shared_ptr<boost::asio::signal_set> sigusr1_set );
+         void write_trace_file();
+         void stop_trace_signal_thread();
+         void place_signal_thread(); ///< apply signal-thread-cpus to the calling thread
          void set_program_options();
          void write_default_config(const bfs::path& cfg_file);
          void print_default_config(std::ostream& os);
@@ -272,6 +544,22 @@ namespace appbase {
 
          void shutdown();
 
+         /**
+          * run action on each of plugins once the plugins it depends on are done, independent plugins concurrently
+          * on up to num_threads threads, and return the critical path. plugins must be ordered dependencies first.
+          * The duration of each action is recorded as step of the plugin's profile. With dependents_first a plugin
+          * instead waits for the plugins that depend on it, and plugins must be ordered dependents first.
+          * With more than one thread registry_lock() guards the registries the plugins look up while running.
+          */
+         plugin_critical_path run_plugins(const vector<abstract_plugin*>& plugins, size_t num_threads,
+                                          const std::function<void(abstract_plugin&)>& action,
+                                          const std::function<bool()>& stop,
+                                          std::chrono::microseconds plugin_profile::* step,
+                                          bool dependents_first = false);
+
+         /// the profile entry of plug, created on first use; must hold plugin_state_mtx
+         plugin_profile& profile_of(abstract_plugin& plug);
+
          std::unique_ptr<class application_impl> my;
 
    };
@@ -282,7 +570,7 @@ namespace appbase {
    template<typename Impl>
    class plugin : public abstract_plugin {
       public:
-         plugin():_name(boost::core::demangle(typeid(Impl).name())){}
+         plugin():_name(impl::demangled_name<Impl>()){}
          virtual ~plugin(){}
 
          virtual state get_state()const override         { return _state; }
@@ -292,12 +580,15 @@ namespace appbase {
             static_cast<Impl*>(this)->plugin_requires([&](auto& plug){});
          }
 
+         virtual void visit_dependencies( const std::function<void(abstract_plugin&)>& visitor ) override {
+            static_cast<Impl*>(this)->plugin_requires([&](auto& plug){ visitor(plug); });
+         }
+
          virtual void initialize(const variables_map& options) override {
             if(_state == registered) {
                _state = initialized;
                static_cast<Impl*>(this)->plugin_requires([&](auto& plug){ plug.initialize(options); });
                static_cast<Impl*>(this)->plugin_initialize(options);
-               //ilog( "initializing plugin ${name}", ("name",name()) );
                app().plugin_initialized(*this);
             }
             assert(_state == initialized); /// if initial state was not registered, final state cannot be initialized
@@ -319,7 +610,6 @@ namespace appbase {
          virtual void shutdown() override {
             if(_state == started) {
                _state = stopped;
-               //ilog( "shutting down plugin ${name}", ("name",name()) );
                static_cast<Impl*>(this)->plugin_shutdown();
             }
          }
@@ -332,14 +622,145 @@ namespace appbase {
          std::string _name;
    };
 
-   template<typename Data, typename DispatchPolicy>
-   void channel<Data,DispatchPolicy>::publish(int priority, const Data& data) {
+   template<typename Data, typename DispatchPolicy, typename Backend>
+   void channel<Data,DispatchPolicy,Backend>::publish(int priority, const Data& data) {
       if (has_subscribers()) {
-         // this will copy data into the lambda
-         app().post( priority, [this, data]() {
-            _signal(data);
-         });
+         if (_bounded) {
+            push_bounded( priority, Data(data) );
+            return;
+         }
+         // this will copy data into the envelope
+         post_envelope( priority, _envelopes.make(data) );
       }
    }
 
+   template<typename Data, typename DispatchPolicy, typename Backend>
+   void channel<Data,DispatchPolicy,Backend>::publish(int priority, Data&& data) {
+      if (has_subscribers()) {
+         if (_bounded) {
+            push_bounded( priority, std::move(data) );
+            return;
+         }
+         post_envelope( priority, _envelopes.make(std::move(data)) );
+      }
+   }
+
+   template<typename Data, typename DispatchPolicy, typename Backend>
+   template<typename... Args>
+   void channel<Data,DispatchPolicy,Backend>::emplace_publish(int priority, Args&&... args) {
+      if (has_subscribers()) {
+         if (_bounded) {
+            push_bounded( priority, Data(std::forward<Args>(args)...) );
+            return;
+         }
+         post_envelope( priority, _envelopes.make(std::forward<Args>(args)...) );
+      }
+   }
+
+   template<typename Data, typename DispatchPolicy, typename Backend>
+   void channel<Data,DispatchPolicy,Backend>::post_envelope(int priority, envelope_ptr&& env) {
+      // the lambda only holds the channel and envelope pointers so it is always stored inline in the queue
+      app().post( priority, [this, env = std::move(env)]() {
+         _signal(*env);
+         if( _has_batch_subscribers.load(std::memory_order_relaxed) )
+            _batch_signal(span<const Data>(&*env, 1));
+      });
+   }
+
+   template<typename Data, typename DispatchPolicy, typename Backend>
+   template<typename InputIt>
+   void channel<Data,DispatchPolicy,Backend>::publish_batch(int priority, InputIt first, InputIt last) {
+      if (first != last && has_subscribers()) {
+         if (_bounded) {
+            for( ; first != last; ++first )
+               push_bounded( priority, Data(*first) );
+            return;
+         }
+         // this will copy the items into the batch
+         auto batch = _batches.make(first, last);
+         post_batch( priority, std::move(batch) );
+      }
+   }
+
+   template<typename Data, typename DispatchPolicy, typename Backend>
+   void channel<Data,DispatchPolicy,Backend>::publish_batch(int priority, std::vector<Data>&& items) {
+      if (!items.empty() && has_subscribers()) {
+         if (_bounded) {
+            for( Data& item : items )
+               push_bounded( priority, std::move(item) );
+            return;
+         }
+         post_batch( priority, _batches.make(std::move(items)) );
+      }
+   }
+
+   template<typename Data, typename DispatchPolicy, typename Backend>
+   void channel<Data,DispatchPolicy,Backend>::post_batch(int priority, batch_ptr&& batch) {
+      // one queued handler for the whole batch, items are dispatched back to back from contiguous storage
+      app().post( priority, [this, batch = std::move(batch)]() {
+         dispatch_batch(*batch);
+      });
+   }
+
+   template<typename Data, typename DispatchPolicy, typename Backend>
+   void channel<Data,DispatchPolicy,Backend>::dispatch_batch(const std::vector<Data>& batch) {
+      if( !_signal.empty() ) {
+         for( const Data& item : batch )
+            _signal(item);
+      }
+      if( _has_batch_subscribers.load(std::memory_order_relaxed) && !batch.empty() )
+         _batch_signal(span<const Data>(batch.data(), batch.size()));
+   }
+
+   template<typename Data, typename DispatchPolicy, typename Backend>
+   void channel<Data,DispatchPolicy,Backend>::push_bounded(int priority, Data&& data) {
+      if( !_bounded->push(std::move(data)) )
+         return;
+      // the queued handler does not own any items, it takes whatever is pending when it runs
+      app().post( priority, [this]() {
+         auto batch = _batches.make();
+         _bounded->take(*batch);
+         dispatch_batch(*batch);
+      });
+   }
+
+   template<typename FunctionSig, typename DispatchPolicy, typename Backend>
+   template<typename... CallArgs>
+   auto method<FunctionSig,DispatchPolicy,Backend>::call_async(int priority, CallArgs&&... args) -> std::future<result_type> {
+      impl::async_method_call<method, result_type, std::decay_t<CallArgs>...> call{this, {}, std::tuple<std::decay_t<CallArgs>...>(std::forward<CallArgs>(args)...)};
+      auto result = call.promise.get_future();
+      app().post( priority, std::move(call) );
+      return result;
+   }
+
+   template<typename FunctionSig, typename DispatchPolicy, typename Backend>
+   template<typename... CallArgs>
+   auto method<FunctionSig,DispatchPolicy,Backend>::call_async(strand& s, int priority, CallArgs&&... args) -> std::future<result_type> {
+      impl::async_method_call<method, result_type, std::decay_t<CallArgs>...> call{this, {}, std::tuple<std::decay_t<CallArgs>...>(std::forward<CallArgs>(args)...)};
+      auto result = call.promise.get_future();
+      s.post( priority, std::move(call) );
+      return result;
+   }
+
+   template<typename Func>
+   void strand::post(int priority, Func&& func) {
+      impl::handler_function f(std::forward<Func>(func));
+      std::lock_guard<std::mutex> g(_mtx);
+      _pending.push_back(pending_handler{priority, --_order, std::move(f)});
+      std::push_heap(_pending.begin(), _pending.end());
+      // a running handler reschedules the strand when it completes
+      if( !_running && (!_scheduled || priority > _scheduled_priority) )
+         schedule(priority);
+   }
+
+#ifdef APPBASE_HAS_COROUTINES
+   inline void impl::post_resume(int priority, std::coroutine_handle<> h) {
+      app().post( priority, impl::resume_handle(h) );
+   }
+
+   inline void impl::post_rethrow(std::exception_ptr e) {
+      app().post( priority::highest, [e]() { std::rethrow_exception(e); } );
+   }
+#endif
+
 }
@@ -4,14 +4,273 @@
 #pragma push_macro("N")
 #undef N
 
+#include <appbase/flat_signal.hpp>
+
+// with C++20, Boost.Asio 1.74 uses std::exchange without including <utility>
+#include <utility>
 #include <boost/asio.hpp>
 #include <boost/signals2.hpp>
 #include <boost/exception/diagnostic_information.hpp>
+#include <boost/throw_exception.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <iterator>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
 
 namespace appbase {
 
    using erased_channel_ptr = std::unique_ptr<void, void(*)(void*)>;
 
+   /**
+    * Non-owning view of a contiguous sequence of T, as delivered to batch subscribers of a channel
+    */
+   template<typename T>
+   class span {
+      public:
+         using value_type = std::remove_cv_t<T>;
+         using iterator   = T*;
+
+         span() = default;
+         span(T* data, size_t size) : _data(data), _size(size) {}
+
+         T*     data() const  { return _data; }
+         size_t size() const  { return _size; }
+         bool   empty() const { return _size == 0; }
+
+         T* begin() const { return _data; }
+         T* end() const   { return _data + _size; }
+
+         T& operator[](size_t i) const { return _data[i]; }
+
+      private:
+         T*     _data = nullptr;
+         size_t _size = 0;
+   };
+
+   namespace impl {
+      /**
+       * Thread-safe pool of storage for objects of type T. Released storage is kept for reuse (up to max_cached blocks)
+       * so that steady state create/destroy does not allocate.
+       */
+      template<typename T>
+      class object_pool {
+         public:
+            static constexpr size_t max_cached = 1024;
+
+            /**
+             * Owning pointer to an object created by the pool, returns it to the pool when destroyed
+             */
+            class pooled_ptr {
+               public:
+                  pooled_ptr(object_pool* pool, T* obj) : _pool(pool), _obj(obj) {}
+                  pooled_ptr(pooled_ptr&& other) noexcept : _pool(other._pool), _obj(other._obj) { other._obj = nullptr; }
+                  pooled_ptr(const pooled_ptr&) = delete;
+                  pooled_ptr& operator=(const pooled_ptr&) = delete;
+                  pooled_ptr& operator=(pooled_ptr&&) = delete;
+                  ~pooled_ptr() {
+                     if( _obj )
+                        _pool->destroy(_obj);
+                  }
+
+                  T& operator*() const  { return *_obj; }
+                  T* operator->() const { return _obj; }
+
+               private:
+                  object_pool* _pool;
+                  T*           _obj;
+            };
+
+            object_pool() = default;
+            object_pool(const object_pool&) = delete;
+            object_pool& operator=(const object_pool&) = delete;
+
+            ~object_pool() {
+               for( void* p : _free )
+                  ::operator delete(p);
+            }
+
+            template<typename... Args>
+            T* create(Args&&... args) {
+               void* p = nullptr;
+               {
+                  std::lock_guard<std::mutex> g(_mtx);
+                  if( !_free.empty() ) {
+                     p = _free.back();
+                     _free.pop_back();
+                  }
+               }
+               if( !p )
+                  p = ::operator new(sizeof(T));
+               try {
+                  return new (p) T(std::forward<Args>(args)...);
+               } catch( ... ) {
+                  release(p);
+                  throw;
+               }
+            }
+
+            template<typename... Args>
+            pooled_ptr make(Args&&... args) {
+               return pooled_ptr(this, create(std::forward<Args>(args)...));
+            }
+
+            void destroy(T* obj) {
+               obj->~T();
+               release(obj);
+            }
+
+         private:
+            void release(void* p) {
+               {
+                  std::lock_guard<std::mutex> g(_mtx);
+                  if( _free.size() < max_cached ) {
+                     _free.push_back(p);
+                     return;
+                  }
+               }
+               ::operator delete(p);
+            }
+
+            std::mutex         _mtx;
+            std::vector<void*> _free;
+      };
+   }
+
+   /**
+    * What a bounded channel does with a publish while capacity items are already pending
+    */
+   enum class overflow_policy {
+      block,        ///< the publishing thread waits until the pending items have been dispatched
+      drop_oldest,  ///< the oldest pending item is dropped
+      drop_newest,  ///< the published item is dropped
+      coalesce      ///< a pending item with the same key is replaced, a new key drops the oldest pending item
+   };
+
+   /**
+    * Counters of a bounded channel
+    */
+   struct channel_stats {
+      uint64_t dropped    = 0;  ///< items dropped by drop_oldest, drop_newest or coalesce on overflow
+      uint64_t coalesced  = 0;  ///< pending items replaced by a newer item with the same key
+      size_t   pending    = 0;  ///< items waiting for dispatch
+      size_t   high_water = 0;  ///< the most items that were pending at once
+   };
+
+   namespace impl {
+      /**
+       * Pending items of a bounded channel. Only one dispatch of the pending items is posted at a time,
+       * the dispatch takes all pending items at once.
+       */
+      template<typename Data>
+      class bounded_queue {
+         public:
+            using key_function = std::function<uint64_t(const Data&)>;
+
+            bounded_queue(size_t capacity, overflow_policy policy, key_function key)
+            :_capacity(capacity), _policy(policy), _key(std::move(key))
+            {}
+
+            /**
+             * add data to the pending items according to the overflow policy
+             * @return true if the caller must post a dispatch of the pending items
+             */
+            bool push(Data&& data) {
+               std::unique_lock<std::mutex> g(_mtx);
+               const uint64_t key = _policy == overflow_policy::coalesce ? _key(data) : 0;
+               while( true ) {
+                  if( _policy == overflow_policy::coalesce ) {
+                     auto itr = _key_seq.find(key);
+                     if( itr != _key_seq.end() ) {
+                        _pending[itr->second - _front_seq].data = std::move(data);
+                        ++_stats.coalesced;
+                        return false;
+                     }
+                  }
+                  if( _pending.size() < _capacity )
+                     break;
+                  if( _policy == overflow_policy::block ) {
+                     // another producer may add the same key while waiting, so check again
+                     _space.wait(g, [this]() { return _pending.size() < _capacity; });
+                     continue;
+                  }
+                  ++_stats.dropped;
+                  if( _policy == overflow_policy::drop_newest )
+                     return false;
+                  pop_front();
+               }
+
+               if( _policy == overflow_policy::coalesce )
+                  _key_seq[key] = _front_seq + _pending.size();
+               _pending.push_back(entry{std::move(data), key});
+               _stats.high_water = std::max(_stats.high_water, _pending.size());
+               if( _dispatch_scheduled )
+                  return false;
+               _dispatch_scheduled = true;
+               return true;
+            }
+
+            /**
+             * move all pending items to the end of out
+             */
+            void take(std::vector<Data>& out) {
+               {
+                  std::lock_guard<std::mutex> g(_mtx);
+                  out.reserve(out.size() + _pending.size());
+                  for( auto& e : _pending )
+                     out.push_back(std::move(e.data));
+                  _front_seq += _pending.size();
+                  _pending.clear();
+                  _key_seq.clear();
+                  _dispatch_scheduled = false;
+               }
+               if( _policy == overflow_policy::block )
+                  _space.notify_all();
+            }
+
+            channel_stats stats() const {
+               std::lock_guard<std::mutex> g(_mtx);
+               channel_stats result = _stats;
+               result.pending = _pending.size();
+               return result;
+            }
+
+         private:
+            struct entry {
+               Data     data;
+               uint64_t key;
+            };
+
+            void pop_front() {
+               if( _policy == overflow_policy::coalesce ) {
+                  auto itr = _key_seq.find(_pending.front().key);
+                  if( itr != _key_seq.end() && itr->second == _front_seq )
+                     _key_seq.erase(itr);
+               }
+               _pending.pop_front();
+               ++_front_seq;
+            }
+
+            const size_t                           _capacity;
+            const overflow_policy                  _policy;
+            const key_function                     _key;
+
+            mutable std::mutex                     _mtx;
+            std::condition_variable                _space;
+            std::deque<entry>                      _pending;
+            std::unordered_map<uint64_t, uint64_t> _key_seq;       ///< sequence number of the pending item of each key when coalescing
+            uint64_t                               _front_seq = 0; ///< sequence number of _pending.front()
+            bool                                   _dispatch_scheduled = false;
+            channel_stats                          _stats;
+      };
+   }
+
    /**
     * A basic DispatchPolicy that will catch and drop any exceptions thrown
     * during the dispatch of messages on a channel
@@ -39,13 +298,19 @@ namespace appbase {
     * This removes the need to tightly couple different plugins in the application for the use-case of
     * sending data around
     *
-    * Data passed to a channel is *copied*, consider using a shared_ptr if the use-case allows it
+    * Data published to a channel is stored once in a pooled envelope owned by the channel and handed to every
+    * subscriber as a const reference. publish(int, const Data&) copies into the envelope, publish(int, Data&&)
+    * moves and emplace_publish() constructs the data in place.
     *
     * @tparam Data - the type of data to publish
+    * @tparam DispatchPolicy - the combiner used to call subscribers
+    * @tparam Backend - the dispatch backend, @ref signals2_backend or @ref flat_backend
     */
-   template<typename Data, typename DispatchPolicy>
+   template<typename Data, typename DispatchPolicy, typename Backend = signals2_backend>
    class channel final {
       public:
+         using data_type = Data;
+
          /**
           * Type that represents an active subscription to a channel allowing
           * for ownership via RAII and also explicit unsubscribe actions
@@ -76,14 +341,14 @@ namespace appbase {
                handle& operator= (const handle& ) = delete;
 
             private:
-               using handle_type = boost::signals2::connection;
+               using handle_type = typename Backend::connection;
                handle_type _handle;
 
                /**
                 * Construct a handle from an internal represenation of a handle
-                * In this case a boost::signals2::connection
+                * In this case a connection of the dispatch backend
                 *
-                * @param _handle - the boost::signals2::connection to wrap
+                * @param _handle - the connection to wrap
                 */
                handle(handle_type&& _handle)
                :_handle(std::move(_handle))
@@ -99,6 +364,48 @@ namespace appbase {
           */
          void publish(int priority, const Data& data);
 
+         /**
+          * Publish data to a channel.  This data is *moved* into the channel on publish.
+          * @param priority - the priority to use for post
+          * @param data - the data to publish
+          */
+         void publish(int priority, Data&& data);
+
+         /**
+          * Publish data constructed in place from args, without any copy or move of Data.
+          * Nothing is constructed if the channel has no subscribers.
+          * @param priority - the priority to use for post
+          * @param args - the arguments to construct Data from
+          */
+         template<typename... Args>
+         void emplace_publish(int priority, Args&&... args);
+
+         /**
+          * Publish a batch of data as a single dispatch.  The items are *copied* into the channel on publish.
+          * Subscribers receive each item in order, batch subscribers receive all of the items in one call.
+          * @param priority - the priority to use for post
+          * @param first, last - the range of items to publish
+          */
+         template<typename InputIt>
+         void publish_batch(int priority, InputIt first, InputIt last);
+
+         /**
+          * Publish a batch of data as a single dispatch.  The items are *copied* into the channel on publish.
+          * @param priority - the priority to use for post
+          * @param items - the range of items to publish
+          */
+         template<typename Range>
+         void publish_batch(int priority, const Range& items) {
+            publish_batch(priority, std::begin(items), std::end(items));
+         }
+
+         /**
+          * Publish a batch of data as a single dispatch.  The vector is *moved* into the channel on publish.
+          * @param priority - the priority to use for post
+          * @param items - the items to publish
+          */
+         void publish_batch(int priority, std::vector<Data>&& items);
+
          /**
           * subscribe to data on a channel
           * @tparam Callback the type of the callback (functor|lambda)
@@ -110,6 +417,19 @@ namespace appbase {
             return handle(_signal.connect(cb));
          }
 
+         /**
+          * subscribe to batches of data on a channel
+          * The callback receives a span of the items of one publish_batch, or of a single item for publish
+          * @tparam Callback the type of the callback (functor|lambda) taking a `span<const Data>`
+          * @param cb the callback
+          * @return handle to the subscription
+          */
+         template<typename Callback>
+         handle subscribe_batch(Callback cb) {
+            _has_batch_subscribers.store(true);
+            return handle(_batch_signal.connect(cb));
+         }
+
          /**
           * set the dispatcher according to the DispatchPolicy
           * this can be used to set a stateful dispatcher
@@ -121,6 +441,39 @@ namespace appbase {
          auto set_dispatcher(const DispatchPolicy& policy ) -> std::enable_if_t<std::is_copy_constructible<DispatchPolicy>::value,void>
          {
             _signal.set_combiner(policy);
+            _batch_signal.set_combiner(policy);
+         }
+
+         using key_function = typename impl::bounded_queue<Data>::key_function;
+
+         /**
+          * Bound the number of items of this channel waiting for dispatch. Instead of posting a dispatch per publish,
+          * published items are kept in a per-channel queue of at most capacity items and a single dispatch of them
+          * is posted at a time; policy decides what happens to a publish while the queue is full.
+          *
+          * Must be called before anything is published on the channel.
+          * With overflow_policy::block a publish must not be made from a handler of a single threaded exec(),
+          * as the pending items can only be dispatched once that handler returns.
+          *
+          * @param capacity - the maximum number of pending items, must be greater than 0
+          * @param policy - the @ref overflow_policy
+          * @param key - for overflow_policy::coalesce, returns the key identifying the item so that only the latest
+          *              item of each key is delivered
+          */
+         void set_capacity(size_t capacity, overflow_policy policy, key_function key = key_function()) {
+            if( capacity == 0 )
+               BOOST_THROW_EXCEPTION(std::logic_error("channel capacity must be greater than 0"));
+            if( policy == overflow_policy::coalesce && !key )
+               BOOST_THROW_EXCEPTION(std::logic_error("coalescing channel requires a key function"));
+            _bounded = std::make_unique<impl::bounded_queue<Data>>(capacity, policy, std::move(key));
+         }
+
+         /**
+          * Returns the drop and queue depth counters of a channel bounded by set_capacity(),
+          * all zero for an unbounded channel
+          */
+         channel_stats get_stats() const {
+            return _bounded ? _bounded->stats() : channel_stats();
          }
 
          /**
@@ -128,6 +481,8 @@ namespace appbase {
           */
          bool has_subscribers() {
             auto connections = _signal.num_slots();
+            if( _has_batch_subscribers.load(std::memory_order_relaxed) )
+               connections += _batch_signal.num_slots();
             return connections > 0;
          }
 
@@ -168,7 +523,36 @@ namespace appbase {
             return erased_channel_ptr(new channel(), &deleter);
          }
 
-         boost::signals2::signal<void(const Data&), DispatchPolicy> _signal;
+         using envelope_ptr = typename impl::object_pool<Data>::pooled_ptr;
+
+         /**
+          * post a dispatch of an envelope to all subscribers
+          */
+         void post_envelope(int priority, envelope_ptr&& env);
+
+         using batch_ptr = typename impl::object_pool<std::vector<Data>>::pooled_ptr;
+
+         /**
+          * post a single dispatch of all items of a batch to all subscribers
+          */
+         void post_batch(int priority, batch_ptr&& batch);
+
+         /**
+          * dispatch the items of a batch to all subscribers
+          */
+         void dispatch_batch(const std::vector<Data>& batch);
+
+         /**
+          * add an item to the pending items of a bounded channel, posting their dispatch if needed
+          */
+         void push_bounded(int priority, Data&& data);
+
+         typename Backend::template signal<void(const Data&), DispatchPolicy>      _signal;
+         typename Backend::template signal<void(span<const Data>), DispatchPolicy> _batch_signal;
+         std::atomic<bool>                    _has_batch_subscribers{false}; ///< set by the first subscribe_batch, skips _batch_signal until then
+         impl::object_pool<Data>              _envelopes;
+         impl::object_pool<std::vector<Data>> _batches;
+         std::unique_ptr<impl::bounded_queue<Data>> _bounded;
 
          friend class appbase::application;
    };
@@ -178,10 +562,11 @@ namespace appbase {
     * @tparam Tag - API specific discriminator used to distinguish between otherwise identical data types
     * @tparam Data - the typ of the Data the channel carries
     * @tparam DispatchPolicy - The dispatch policy to use for this channel (defaults to @ref drop_exceptions)
+    * @tparam Backend - The dispatch backend, @ref signals2_backend (default) or the lower overhead @ref flat_backend
     */
-   template< typename Tag, typename Data, typename DispatchPolicy = drop_exceptions >
+   template< typename Tag, typename Data, typename DispatchPolicy = drop_exceptions, typename Backend = signals2_backend >
    struct channel_decl {
-      using channel_type = channel<Data, DispatchPolicy>;
+      using channel_type = channel<Data, DispatchPolicy, Backend>;
       using tag_type = Tag;
    };
 
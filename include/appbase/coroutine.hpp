@@ -0,0 +1,192 @@
+#pragma once
+
+// Coroutine support needs C++20, e.g. configure with -DCMAKE_CXX_STANDARD=20
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+#if __has_include(<coroutine>)
+#define APPBASE_HAS_COROUTINES 1
+#endif
+#endif
+
+#ifdef APPBASE_HAS_COROUTINES
+#include <appbase/channel.hpp>
+
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+namespace appbase {
+
+   namespace impl {
+      /**
+       * Queue handler resuming a suspended coroutine. Only holds the coroutine handle, so it is stored inline
+       * in the handler_function of the queue entry. A coroutine whose handler is destroyed without running,
+       * e.g. because it was still pending when exec() returned, is destroyed with it.
+       */
+      class resume_handle {
+         public:
+            explicit resume_handle(std::coroutine_handle<> h) noexcept : _h(h) {}
+            resume_handle(resume_handle&& other) noexcept : _h(std::exchange(other._h, {})) {}
+            resume_handle& operator=(resume_handle&& other) = delete;
+
+            ~resume_handle() {
+               if( _h )
+                  _h.destroy();
+            }
+
+            void operator()() { std::exchange(_h, {}).resume(); }
+
+         private:
+            std::coroutine_handle<> _h;
+      };
+
+      /// resume h from the application queue with given priority, defined in application.hpp
+      inline void post_resume(int priority, std::coroutine_handle<> h);
+
+      /// make exec() rethrow e, defined in application.hpp
+      inline void post_rethrow(std::exception_ptr e);
+
+      /// returned by application::yield()
+      struct yield_awaitable {
+         int priority;
+
+         bool await_ready() const noexcept { return false; }
+         void await_suspend(std::coroutine_handle<> h) { post_resume(priority, h); }
+         void await_resume() const noexcept {}
+      };
+   }
+
+   /**
+    * Return type of a fire-and-forget coroutine running on the application queue.
+    *
+    * The coroutine starts running when called and runs until its first co_await; it owns its frame, which it
+    * destroys when it completes. An exception escaping the coroutine is rethrown from exec() like the exception
+    * of any other handler.
+    *
+    * Example:
+    *   appbase::task poll() {
+    *      for( ;; ) {
+    *         do_some_work();
+    *         co_await app().yield( priority::low );
+    *      }
+    *   }
+    */
+   class task {
+      public:
+         struct promise_type {
+            std::exception_ptr exception;
+
+            task get_return_object() noexcept { return {}; }
+            std::suspend_never initial_suspend() noexcept { return {}; }
+
+            auto final_suspend() noexcept {
+               struct final_awaiter {
+                  bool await_ready() noexcept { return false; }
+                  void await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+                     std::exception_ptr e = std::move(h.promise().exception);
+                     h.destroy();
+                     if( e )
+                        impl::post_rethrow(std::move(e));
+                  }
+                  void await_resume() noexcept {}
+               };
+               return final_awaiter{};
+            }
+
+            void return_void() noexcept {}
+            void unhandled_exception() noexcept { exception = std::current_exception(); }
+         };
+   };
+
+   /**
+    * Subscription to a channel that a coroutine awaits, `co_await reader.next()` returns the next published item.
+    *
+    * Items are copied into the reader as they are dispatched and buffered until read. A suspended coroutine is
+    * resumed from the application queue with the reader's priority when an item arrives. Only one coroutine
+    * may await a reader at a time. A coroutine waiting for an item that never arrives is never resumed, nor
+    * destroyed.
+    *
+    * Example:
+    *   appbase::task consume() {
+    *      channel_reader reader( app().get_channel<my_channel>(), priority::medium );
+    *      for( ;; )
+    *         handle( co_await reader.next() );
+    *   }
+    */
+   template<typename Data, typename DispatchPolicy, typename Backend>
+   class channel_reader {
+      private:
+         struct state {
+            explicit state(int priority) : priority(priority) {}
+
+            void push(const Data& data) {
+               std::coroutine_handle<> waiter;
+               {
+                  std::lock_guard<std::mutex> g(mtx);
+                  items.push_back(data);
+                  waiter = std::exchange(this->waiter, {});
+               }
+               if( waiter )
+                  impl::post_resume(priority, waiter);
+            }
+
+            const int                priority;
+            std::mutex               mtx;
+            std::deque<Data>         items;
+            std::coroutine_handle<>  waiter;
+         };
+
+      public:
+         using channel_type = channel<Data, DispatchPolicy, Backend>;
+
+         channel_reader(channel_type& chan, int priority)
+         : _state(std::make_shared<state>(priority))
+         , _handle(chan.subscribe([s = _state](const Data& data) { s->push(data); }))
+         {}
+
+         auto next() {
+            struct next_awaitable {
+               state& s;
+
+               bool await_ready() {
+                  std::lock_guard<std::mutex> g(s.mtx);
+                  return !s.items.empty();
+               }
+               bool await_suspend(std::coroutine_handle<> h) {
+                  std::lock_guard<std::mutex> g(s.mtx);
+                  // an item may have arrived since await_ready()
+                  if( !s.items.empty() )
+                     return false;
+                  s.waiter = h;
+                  return true;
+               }
+               Data await_resume() {
+                  std::lock_guard<std::mutex> g(s.mtx);
+                  Data data = std::move(s.items.front());
+                  s.items.pop_front();
+                  return data;
+               }
+            };
+            return next_awaitable{*_state};
+         }
+
+         /// number of items buffered and not read yet
+         size_t pending() const {
+            std::lock_guard<std::mutex> g(_state->mtx);
+            return _state->items.size();
+         }
+
+         void unsubscribe() { _handle.unsubscribe(); }
+
+      private:
+         std::shared_ptr<state>          _state; ///< shared with the subscription, which may outlive the reader
+         typename channel_type::handle   _handle;
+   };
+
+   template<typename Data, typename DispatchPolicy, typename Backend>
+   channel_reader(channel<Data, DispatchPolicy, Backend>&, int) -> channel_reader<Data, DispatchPolicy, Backend>;
+
+} // appbase
+#endif
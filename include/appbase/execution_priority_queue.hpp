@@ -1,7 +1,32 @@
 #pragma once
+#include <appbase/trace.hpp>
+#include <appbase/watchdog.hpp>
+
+// with C++20, Boost.Asio 1.74 uses std::exchange without including <utility>
+#include <utility>
 #include <boost/asio.hpp>
+#include <boost/preprocessor/stringize.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
 
-#include <queue>
+/**
+ * Tag naming the posting site of a handler, e.g. `app().post( priority::medium, APPBASE_HERE, lambda )`.
+ * Tags must be strings with static storage duration.
+ */
+#define APPBASE_HERE __FILE__ ":" BOOST_PP_STRINGIZE(__LINE__)
 
 namespace appbase {
 // adapted from: https://www.boost.org/doc/libs/1_69_0/doc/html/boost_asio/example/cpp11/invocation/prioritised_handlers.cpp
@@ -16,38 +41,831 @@ struct priority {
    static constexpr int highest     = std::numeric_limits<int>::max();
 };
 
+/**
+ * Snapshot of the instrumentation of an execution_priority_queue, see execution_priority_queue::set_metrics_enabled()
+ */
+struct queue_metrics {
+   static constexpr size_t histogram_buckets = 32;
+   /// bucket 0 counts zero, bucket i > 0 counts values in [2^(i-1), 2^i)
+   using histogram = std::array<uint64_t, histogram_buckets>;
+
+   struct priority_metrics {
+      int                      priority = 0;
+      uint64_t                 executed = 0;
+      std::chrono::nanoseconds total_wait{0};  ///< time from add() / add_concurrent() until execution started
+      std::chrono::nanoseconds max_wait{0};
+      std::chrono::nanoseconds total_run{0};   ///< time spent executing
+      std::chrono::nanoseconds max_run{0};
+      histogram                wait_us{};      ///< wait times in microseconds
+   };
+
+   struct handler_metrics {
+      const char*              tag = nullptr;  ///< posting site, nullptr if the handler was added without a tag
+      int                      priority = 0;
+      std::chrono::nanoseconds run{0};
+   };
+
+   static constexpr size_t max_longest = 16;
+
+   std::vector<priority_metrics> priorities;  ///< one per priority executed, highest priority first
+   histogram                     depth{};     ///< number of handlers queued, sampled each time one is executed
+   std::vector<handler_metrics>  longest;     ///< the longest running handlers, longest first
+};
+
+namespace impl {
+
+   /// hint to the CPU that the calling thread is spinning
+   inline void cpu_relax()
+   {
+#if defined(__x86_64__) || defined(__i386__)
+      _mm_pause();
+#elif defined(__aarch64__)
+      asm volatile("yield");
+#endif
+   }
+
+   /// log2 histogram bucket of v, see queue_metrics::histogram
+   inline size_t histogram_bucket(uint64_t v)
+   {
+      size_t b = 0;
+      while( v && b + 1 < queue_metrics::histogram_buckets ) {
+         v >>= 1;
+         ++b;
+      }
+      return b;
+   }
+
+   /**
+    * Accumulates queue_metrics, called from every thread that executes handlers
+    */
+   class metrics_recorder {
+   public:
+      void record_wait(int priority, std::chrono::nanoseconds wait)
+      {
+         std::lock_guard<std::mutex> g(mtx_);
+         auto& m = find(priority);
+         m.total_wait += wait;
+         m.max_wait = std::max(m.max_wait, wait);
+         ++m.wait_us[histogram_bucket(std::chrono::duration_cast<std::chrono::microseconds>(wait).count())];
+      }
+
+      void record_run(int priority, const char* tag, std::chrono::nanoseconds run)
+      {
+         std::lock_guard<std::mutex> g(mtx_);
+         auto& m = find(priority);
+         ++m.executed;
+         m.total_run += run;
+         m.max_run = std::max(m.max_run, run);
+
+         auto& longest = metrics_.longest;
+         if( longest.size() == queue_metrics::max_longest && run <= longest.back().run )
+            return;
+         if( longest.size() == queue_metrics::max_longest )
+            longest.pop_back();
+         auto pos = std::find_if(longest.begin(), longest.end(), [&](const auto& h) { return h.run < run; });
+         longest.insert(pos, queue_metrics::handler_metrics{tag, priority, run});
+      }
+
+      void record_depth(size_t depth)
+      {
+         std::lock_guard<std::mutex> g(mtx_);
+         ++metrics_.depth[histogram_bucket(depth)];
+      }
+
+      queue_metrics snapshot() const
+      {
+         std::lock_guard<std::mutex> g(mtx_);
+         return metrics_;
+      }
+
+      void reset()
+      {
+         std::lock_guard<std::mutex> g(mtx_);
+         metrics_ = queue_metrics();
+      }
+
+   private:
+      queue_metrics::priority_metrics& find(int priority)
+      {
+         auto& priorities = metrics_.priorities;
+         auto pos = std::find_if(priorities.begin(), priorities.end(), [&](const auto& m) { return m.priority <= priority; });
+         if( pos == priorities.end() || pos->priority != priority ) {
+            pos = priorities.insert(pos, queue_metrics::priority_metrics());
+            pos->priority = priority;
+         }
+         return *pos;
+      }
+
+      mutable std::mutex mtx_;
+      queue_metrics      metrics_;
+   };
+
+   /**
+    * Handler wrapper recording wait and run time, only used while metrics are enabled
+    */
+   template <typename F>
+   struct instrumented_handler {
+      F                                     function;
+      metrics_recorder*                     recorder;
+      const char*                           tag;
+      int                                   priority;
+      std::chrono::steady_clock::time_point enqueued;
+
+      void operator()()
+      {
+         const auto start = std::chrono::steady_clock::now();
+         recorder->record_wait(priority, start - enqueued);
+         struct record_run {
+            instrumented_handler&                 h;
+            std::chrono::steady_clock::time_point start;
+            ~record_run() { h.recorder->record_run(h.priority, h.tag, std::chrono::steady_clock::now() - start); }
+         } guard{*this, start};
+         function();
+      }
+   };
+
+   struct handler_ops {
+      void (*invoke)(void* obj);
+      void (*relocate)(void* dst, void* src); ///< move-construct into dst and destroy src
+      void (*destroy)(void* obj);
+   };
+
+   template <typename F>
+   struct inline_handler {
+      static void invoke(void* obj)              { (*static_cast<F*>(obj))(); }
+      static void relocate(void* dst, void* src) { new (dst) F(std::move(*static_cast<F*>(src))); static_cast<F*>(src)->~F(); }
+      static void destroy(void* obj)             { static_cast<F*>(obj)->~F(); }
+   };
+
+   template <typename F>
+   struct boxed_handler {
+      static void invoke(void* obj)              { (**static_cast<F**>(obj))(); }
+      static void relocate(void* dst, void* src) { *static_cast<F**>(dst) = *static_cast<F**>(src); }
+      static void destroy(void* obj)             { delete *static_cast<F**>(obj); }
+   };
+
+   /**
+    * Box of a handler stored in memory of an allocator, which is also used to release it
+    */
+   template <typename F, typename Allocator>
+   struct allocated_handler {
+      using allocator_type = typename std::allocator_traits<Allocator>::template rebind_alloc<allocated_handler>;
+
+      allocator_type alloc;
+      F              function;
+
+      static void invoke(void* obj)              { (*static_cast<allocated_handler**>(obj))->function(); }
+      static void relocate(void* dst, void* src) { *static_cast<allocated_handler**>(dst) = *static_cast<allocated_handler**>(src); }
+      static void destroy(void* obj)
+      {
+         allocated_handler* h = *static_cast<allocated_handler**>(obj);
+         allocator_type a(h->alloc);
+         h->~allocated_handler();
+         std::allocator_traits<allocator_type>::deallocate(a, h, 1);
+      }
+   };
+
+   template <typename F>
+   constexpr handler_ops inline_handler_ops{ &inline_handler<F>::invoke, &inline_handler<F>::relocate, &inline_handler<F>::destroy };
+
+   template <typename F>
+   constexpr handler_ops boxed_handler_ops{ &boxed_handler<F>::invoke, &boxed_handler<F>::relocate, &boxed_handler<F>::destroy };
+
+   template <typename F, typename Allocator>
+   constexpr handler_ops allocated_handler_ops{ &allocated_handler<F, Allocator>::invoke, &allocated_handler<F, Allocator>::relocate,
+                                                &allocated_handler<F, Allocator>::destroy };
+
+   /**
+    * Move-only, type-erased void() callable with inline storage.
+    *
+    * Functions that fit in inline_size bytes and are nothrow move constructible are stored in place,
+    * anything else is boxed on the heap, or in memory of the allocator given to the std::allocator_arg_t
+    * constructor. Use fits_inline<F> to tell which one will happen.
+    */
+   class handler_function {
+   public:
+      static constexpr std::size_t inline_size = 7 * sizeof(void*);
+
+      template <typename F>
+      using fits_inline = std::integral_constant<bool, sizeof(F) <= inline_size &&
+                                                       alignof(F) <= alignof(std::max_align_t) &&
+                                                       std::is_nothrow_move_constructible<F>::value>;
+
+      handler_function() = default;
+
+      template <typename Function, typename F = std::decay_t<Function>,
+                typename = std::enable_if_t<!std::is_same<F, handler_function>::value>>
+      explicit handler_function(Function&& f)
+      {
+         construct<F>(std::forward<Function>(f), fits_inline<F>{});
+      }
+
+      template <typename Allocator, typename Function, typename F = std::decay_t<Function>>
+      handler_function(std::allocator_arg_t, const Allocator& alloc, Function&& f)
+      {
+         construct<F>(alloc, std::forward<Function>(f), fits_inline<F>{});
+      }
+
+      handler_function(handler_function&& other) noexcept
+            : ops_(other.ops_)
+      {
+         if( ops_ ) {
+            ops_->relocate(&storage_, &other.storage_);
+            other.ops_ = nullptr;
+         }
+      }
+
+      handler_function& operator=(handler_function&& other) noexcept
+      {
+         if( this != &other ) {
+            reset();
+            if( other.ops_ ) {
+               other.ops_->relocate(&storage_, &other.storage_);
+               ops_ = other.ops_;
+               other.ops_ = nullptr;
+            }
+         }
+         return *this;
+      }
+
+      handler_function(const handler_function&) = delete;
+      handler_function& operator=(const handler_function&) = delete;
+
+      ~handler_function() { reset(); }
+
+      void operator()() { ops_->invoke(&storage_); }
+
+      explicit operator bool() const { return ops_ != nullptr; }
+
+   private:
+      template <typename F, typename Function>
+      void construct(Function&& f, std::true_type)
+      {
+         new (&storage_) F(std::forward<Function>(f));
+         ops_ = &inline_handler_ops<F>;
+      }
+
+      template <typename F, typename Function>
+      void construct(Function&& f, std::false_type)
+      {
+         *reinterpret_cast<F**>(&storage_) = new F(std::forward<Function>(f));
+         ops_ = &boxed_handler_ops<F>;
+      }
+
+      template <typename F, typename Allocator, typename Function>
+      void construct(const Allocator&, Function&& f, std::true_type)
+      {
+         construct<F>(std::forward<Function>(f), std::true_type{});
+      }
+
+      template <typename F, typename Allocator, typename Function>
+      void construct(const Allocator& alloc, Function&& f, std::false_type)
+      {
+         using box = allocated_handler<F, Allocator>;
+         typename box::allocator_type a(alloc);
+         box* p = std::allocator_traits<typename box::allocator_type>::allocate(a, 1);
+         try {
+            new (p) box{a, std::forward<Function>(f)};
+         } catch( ... ) {
+            std::allocator_traits<typename box::allocator_type>::deallocate(a, p, 1);
+            throw;
+         }
+         *reinterpret_cast<box**>(&storage_) = p;
+         ops_ = &allocated_handler_ops<F, Allocator>;
+      }
+
+      void reset()
+      {
+         if( ops_ ) {
+            ops_->destroy(&storage_);
+            ops_ = nullptr;
+         }
+      }
+
+      const handler_ops*                                                          ops_ = nullptr;
+      std::aligned_storage_t<inline_size, alignof(std::max_align_t)>             storage_;
+   };
+
+   /**
+    * Thread-safe recycling store of handler memory in power of two size classes from 64 bytes to 1 KiB.
+    * Released blocks are kept for reuse (up to max_cached per size class), larger requests go to the heap.
+    * Every block taken from the heap is counted in the allocation counter given to the constructor.
+    */
+   class handler_arena {
+   public:
+      static constexpr size_t min_block   = 64;
+      static constexpr size_t num_classes = 5;
+      static constexpr size_t max_block   = min_block << (num_classes - 1);
+      static constexpr size_t max_cached  = 256;
+
+      explicit handler_arena(std::atomic<uint64_t>& allocations) : allocations_(allocations) {}
+      handler_arena(const handler_arena&) = delete;
+      handler_arena& operator=(const handler_arena&) = delete;
+
+      ~handler_arena()
+      {
+         for( auto& blocks : free_ )
+            for( void* p : blocks )
+               ::operator delete(p);
+      }
+
+      void* allocate(size_t size)
+      {
+         const size_t c = size_class(size);
+         if( c < num_classes ) {
+            std::lock_guard<std::mutex> g(mtx_);
+            if( !free_[c].empty() ) {
+               void* p = free_[c].back();
+               free_[c].pop_back();
+               return p;
+            }
+         }
+         allocations_.fetch_add(1, std::memory_order_relaxed);
+         return ::operator new(c < num_classes ? min_block << c : size);
+      }
+
+      void deallocate(void* p, size_t size) noexcept
+      {
+         const size_t c = size_class(size);
+         if( c < num_classes ) {
+            std::lock_guard<std::mutex> g(mtx_);
+            if( free_[c].size() < max_cached ) {
+               // reserved up front so that returning a block never allocates
+               if( free_[c].capacity() == 0 )
+                  free_[c].reserve(max_cached);
+               free_[c].push_back(p);
+               return;
+            }
+         }
+         ::operator delete(p);
+      }
+
+   private:
+      static size_t size_class(size_t size)
+      {
+         if( size > max_block )
+            return num_classes;
+         size_t c = 0;
+         while( (min_block << c) < size )
+            ++c;
+         return c;
+      }
+
+      std::atomic<uint64_t>&                      allocations_;
+      std::mutex                                  mtx_;
+      std::array<std::vector<void*>, num_classes> free_;
+   };
+
+   /**
+    * Standard allocator taking its memory from a handler_arena, which must outlive it
+    */
+   template <typename T>
+   class arena_allocator {
+   public:
+      using value_type = T;
+
+      explicit arena_allocator(handler_arena& arena) noexcept : arena_(&arena) {}
+
+      template <typename U>
+      arena_allocator(const arena_allocator<U>& other) noexcept : arena_(other.arena_) {}
+
+      T* allocate(size_t n)
+      {
+         // the arena's blocks have the alignment of operator new
+         if( alignof(T) > alignof(std::max_align_t) )
+            return std::allocator<T>().allocate(n);
+         return static_cast<T*>(arena_->allocate(n * sizeof(T)));
+      }
+
+      void deallocate(T* p, size_t n) noexcept
+      {
+         if( alignof(T) > alignof(std::max_align_t) )
+            std::allocator<T>().deallocate(p, n);
+         else
+            arena_->deallocate(p, n * sizeof(T));
+      }
+
+      template <typename U>
+      bool operator==(const arena_allocator<U>& other) const noexcept { return arena_ == other.arena_; }
+
+      template <typename U>
+      bool operator!=(const arena_allocator<U>& other) const noexcept { return arena_ != other.arena_; }
+
+   private:
+      template <typename> friend class arena_allocator;
+
+      handler_arena* arena_;
+   };
+
+   /**
+    * Growable FIFO ring buffer. Capacity only grows (doubling), so a ring that reached its steady state
+    * size never allocates again.
+    */
+   template <typename T>
+   class ring_buffer {
+   public:
+      ring_buffer() = default;
+      ring_buffer(ring_buffer&& other) noexcept
+            : buf_(std::move(other.buf_)), capacity_(other.capacity_), head_(other.head_), size_(other.size_)
+      {
+         other.capacity_ = other.head_ = other.size_ = 0;
+      }
+      ring_buffer& operator=(ring_buffer&& other) noexcept
+      {
+         clear();
+         buf_ = std::move(other.buf_);
+         capacity_ = other.capacity_; head_ = other.head_; size_ = other.size_;
+         other.capacity_ = other.head_ = other.size_ = 0;
+         return *this;
+      }
+      ~ring_buffer() { clear(); }
+
+      bool   empty() const { return size_ == 0; }
+      size_t size() const  { return size_; }
+
+      T&     front()       { return *at(head_); }
+
+      /// @return true if the buffer had to grow to fit the new element
+      template <typename... Args>
+      bool emplace_back(Args&&... args)
+      {
+         bool grow = size_ == capacity_;
+         if( grow )
+            reserve(capacity_ ? capacity_ * 2 : 16);
+         new (at(head_ + size_)) T(std::forward<Args>(args)...);
+         ++size_;
+         return grow;
+      }
+
+      T pop_front()
+      {
+         T* p = at(head_);
+         T v(std::move(*p));
+         p->~T();
+         head_ = (head_ + 1) & (capacity_ - 1);
+         --size_;
+         return v;
+      }
+
+      void clear()
+      {
+         while( size_ )
+            pop_front();
+      }
+
+   private:
+      using storage = std::aligned_storage_t<sizeof(T), alignof(T)>;
+
+      T* at(size_t i) { return reinterpret_cast<T*>(&buf_[i & (capacity_ - 1)]); }
+
+      void reserve(size_t capacity)
+      {
+         std::unique_ptr<storage[]> buf(new storage[capacity]);
+         for( size_t i = 0; i < size_; ++i ) {
+            T* p = at(head_ + i);
+            new (&buf[i]) T(std::move(*p));
+            p->~T();
+         }
+         buf_ = std::move(buf);
+         capacity_ = capacity;
+         head_ = 0;
+      }
+
+      std::unique_ptr<storage[]> buf_;
+      size_t                     capacity_ = 0; // always 0 or a power of 2
+      size_t                     head_ = 0;
+      size_t                     size_ = 0;
+   };
+
+} // namespace impl
+
 class execution_priority_queue : public boost::asio::execution_context
 {
 public:
 
+   /**
+    * How handlers waiting in the queue are ordered. Both strategies run handlers strictly by priority
+    * and in FIFO order within a priority.
+    */
+   enum class scheduling {
+      binary_heap,  ///< single binary heap ordered by (priority, order), O(log n) add and execute
+      bucketed,     ///< one FIFO ring per distinct priority value, O(1) add and execute. Once max_buckets
+                    ///< distinct priorities are in use, any further priority values fall back to the binary heap
+      bucketed_fair ///< bucketed, except that a non-empty bucket passed over starvation_limit times in a row runs
+                    ///< its oldest handler next, so every priority gets at least one of every starvation_limit + 1
+                    ///< executions while it has handlers waiting. Priorities in the heap fallback are strictly ordered
+   };
+
+   static constexpr size_t max_buckets = 32;
+
+   execution_priority_queue()
+         : queue_id_(next_queue_id())
+   {
+   }
+
+   ~execution_priority_queue()
+   {
+      free_overflow(overflow_.exchange(nullptr));
+      const size_t n = num_producers_.load();
+      for( size_t i = 0; i < n; ++i )
+         free_overflow(producers_[i].load()->overflow_.exchange(nullptr));
+   }
+
+   /**
+    * Add a handler directly into the priority queue.
+    * Only call from a thread that executes the queue.
+    */
    template <typename Function>
    void add(int priority, Function function)
    {
-      std::unique_ptr<queued_handler_base> handler(new queued_handler<Function>(priority, --order_, std::move(function)));
+      add(priority, nullptr, std::move(function));
+   }
 
-      handlers_.push(std::move(handler));
+   /**
+    * Add a handler tagged with its posting site (e.g. APPBASE_HERE) directly into the priority queue.
+    * Only call from a thread that executes the queue.
+    */
+   template <typename Function>
+   void add(int priority, const char* tag, Function function)
+   {
+      impl::handler_function f = make_function(priority, tag, std::move(function));
+      auto lock = consumer_lock();
+      push(priority, std::move(f));
    }
 
-   void execute_all()
+   /**
+    * Add a handler from any thread. Each producer thread gets its own lock-free single-producer ring
+    * buffer, the handler is only moved into the priority queue when an executing thread calls drain_ingress().
+    * Small handlers are stored inline, so in steady state this does not allocate. Up to max_producers threads
+    * have a ring at a time, the ring of a thread that exited is handed to the next new producer.
+    *
+    * @return true if no drain was pending before this call, in which case the caller is responsible for
+    *         arranging for drain_ingress() to be called (e.g. by waking the executing thread) and for
+    *         calling notify_idle_worker()
+    */
+   template <typename Function>
+   bool add_concurrent(int priority, Function function)
+   {
+      return add_concurrent(priority, nullptr, std::move(function));
+   }
+
+   /**
+    * add_concurrent() for a handler tagged with its posting site, e.g. APPBASE_HERE
+    */
+   template <typename Function>
+   bool add_concurrent(int priority, const char* tag, Function function)
+   {
+      impl::handler_function f = make_function(priority, tag, std::move(function));
+      producer_ring* ring = local_ring();
+      if( !ring || !ring->try_push(priority, f) ) {
+         // ring full or no ring available, fall back to a heap allocated node
+         overflow_node* node = new overflow_node{nullptr, priority, std::move(f)};
+         ++heap_allocations_;
+         std::atomic<overflow_node*>& list = ring ? ring->overflow_ : overflow_;
+         node->next = list.load(std::memory_order_relaxed);
+         while( !list.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed) ) {}
+      }
+
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      return !drain_pending_.load(std::memory_order_relaxed) && !drain_pending_.exchange(true);
+   }
+
+   /// true if handlers added by add_concurrent() wait for drain_ingress()
+   bool drain_pending() const
+   {
+      return drain_pending_.load(std::memory_order_relaxed);
+   }
+
+   /**
+    * Move all handlers added by add_concurrent() into the priority queue. Handlers from the same
+    * producer thread keep their relative FIFO order. Only call from a thread that executes the queue.
+    */
+   void drain_ingress()
+   {
+      auto lock = consumer_lock();
+      drain_ingress_locked();
+   }
+
+   /**
+    * Execute up to max_handlers handlers, stopping early once max_duration has elapsed (zero for no time limit).
+    * Before each handler the ingress is drained if a drain is pending, so a higher priority handler posted
+    * through add_concurrent() while the batch runs is executed next.
+    *
+    * @return true if handlers remain in the queue
+    */
+   bool execute_batch(size_t max_handlers, std::chrono::steady_clock::duration max_duration)
    {
-      while (!handlers_.empty()) {
-         handlers_.top()->execute();
-         handlers_.pop();
+      const bool timed = max_duration.count() > 0;
+      const auto deadline = timed ? std::chrono::steady_clock::now() + max_duration : std::chrono::steady_clock::time_point();
+      bool more = execute_highest();
+      for( size_t n = 1; more && n < max_handlers; ++n ) {
+         if( timed && std::chrono::steady_clock::now() >= deadline )
+            break;
+         if( drain_pending_.load(std::memory_order_relaxed) )
+            drain_ingress();
+         more = execute_highest();
       }
+      return more;
+   }
+
+   void execute_all()
+   {
+      while( execute_highest() ) {}
    }
 
    bool execute_highest()
    {
-      if( !handlers_.empty() ) {
-         handlers_.top()->execute();
-         handlers_.pop();
+      auto lock = consumer_lock();
+      if( size_ ) {
+         record_depth();
+         queued_handler handler = pop();
+         const bool was_locked = lock.owns_lock();
+         if( was_locked )
+            lock.unlock();
+         handler.execute();
+         if( was_locked )
+            lock.lock();
+      }
+
+      return size_ != 0;
+   }
+
+   size_t size()
+   {
+      auto lock = consumer_lock();
+      return size_;
+   }
+
+   /**
+    * Priority of the handler execute_highest() would run next. The queue must not be empty.
+    */
+   int highest_priority()
+   {
+      auto lock = consumer_lock();
+      return peek_priority();
+   }
+
+   /**
+    * True if the queue holds a handler of at least given priority, not counting the undrained ingress
+    */
+   bool has_priority_at_least(int priority)
+   {
+      auto lock = consumer_lock();
+      return size_ && peek_priority() >= priority;
+   }
+
+   /**
+    * Remove the handler execute_highest() would run next and return it without running it.
+    * The queue must not be empty.
+    */
+   impl::handler_function take_highest()
+   {
+      auto lock = consumer_lock();
+      return pop().release();
+   }
+
+   /**
+    * Allow add(), drain_ingress(), execute_highest() and run_worker() to be called from several threads at once.
+    * Enable before a second thread starts executing the queue and only disable once it has stopped.
+    */
+   void set_multi_threaded(bool enable)
+   {
+      multi_threaded_.store(enable, std::memory_order_release);
+      stop_workers_ = false;
+   }
+
+   /**
+    * Execute handlers in priority order on the calling thread, sleeping while the queue is empty,
+    * until stop_workers() is called. Requires set_multi_threaded(true).
+    */
+   void run_worker()
+   {
+      std::unique_lock<std::mutex> lock(consumer_mtx_);
+      while( !stop_workers_ ) {
+         drain_ingress_locked();
+         if( size_ ) {
+            record_depth();
+            queued_handler handler = pop();
+            lock.unlock();
+            handler.execute();
+            lock.lock();
+            continue;
+         }
+         // announce before the final check so that a concurrent notify_idle_worker() is never missed
+         ++idle_workers_;
+         drain_ingress_locked();
+         if( !size_ && !stop_workers_ )
+            workers_cv_.wait(lock);
+         --idle_workers_;
+      }
+   }
+
+   /**
+    * Make all run_worker() calls return once their current handler completes.
+    */
+   void stop_workers()
+   {
+      std::lock_guard<std::mutex> g(consumer_mtx_);
+      stop_workers_ = true;
+      workers_cv_.notify_all();
+   }
+
+   /**
+    * Wake one worker sleeping in run_worker() so it drains the ingress. Call after add_concurrent() returns true.
+    */
+   void notify_idle_worker()
+   {
+      if( idle_workers_.load() ) {
+         std::lock_guard<std::mutex> g(consumer_mtx_);
+         workers_cv_.notify_one();
       }
+   }
+
+   /**
+    * Select how waiting handlers are ordered, see @ref scheduling. Defaults to scheduling::binary_heap.
+    * Can only be changed while the queue is empty.
+    */
+   void set_scheduling(scheduling s)
+   {
+      auto lock = consumer_lock();
+      if( size_ != 0 )
+         BOOST_THROW_EXCEPTION(std::logic_error("execution_priority_queue scheduling can only be changed while empty"));
+      scheduling_ = s;
+   }
+
+   scheduling get_scheduling() const { return scheduling_; }
+
+   /**
+    * How many handlers of other priorities may run while a bucket has handlers waiting before that bucket
+    * runs one, for scheduling::bucketed_fair. Defaults to 16.
+    */
+   void set_starvation_limit(uint32_t limit)
+   {
+      auto lock = consumer_lock();
+      starvation_limit_ = std::max<uint32_t>(limit, 1);
+   }
+
+   uint32_t get_starvation_limit() const { return starvation_limit_; }
+
+   /**
+    * Number of heap allocations made while queueing handlers: handlers too large to be stored inline (for
+    * functions of an executor only those the recycling arena had no free block for), ingress overflow nodes,
+    * producer ring creation and growth of the queue storage. Expected to stop increasing once the queue
+    * reaches its steady state size.
+    */
+   uint64_t heap_allocations() const { return heap_allocations_.load(std::memory_order_relaxed); }
+
+   /**
+    * Record per priority wait and run times, a histogram of the queue depth and the longest running handlers.
+    * Only handlers added while enabled are measured. Disabled (the default) handlers are queued unchanged,
+    * enabled each one is wrapped and timed, which stores handlers too large for the inline storage on the heap.
+    * Can be toggled at any time from any thread.
+    */
+   void set_metrics_enabled(bool enable)
+   {
+      if( enable ) {
+         std::lock_guard<std::mutex> g(producers_mtx_);
+         if( !metrics_owner_ ) {
+            metrics_owner_ = std::make_unique<impl::metrics_recorder>();
+            metrics_.store(metrics_owner_.get(), std::memory_order_release);
+         }
+      }
+      metrics_enabled_.store(enable, std::memory_order_release);
+   }
 
-      return !handlers_.empty();
+   /**
+    * Number of asynchronous operations that announced work on an executor of this queue and have not finished yet,
+    * e.g. asio operations pending with a handler made by wrap()
+    */
+   size_t outstanding_work() const { return outstanding_work_.load(std::memory_order_acquire); }
+
+   bool metrics_enabled() const { return metrics_enabled_.load(std::memory_order_relaxed); }
+
+   /**
+    * @return the metrics recorded since the queue was created or reset_metrics() was called
+    */
+   queue_metrics metrics_snapshot()
+   {
+      std::lock_guard<std::mutex> g(producers_mtx_);
+      return metrics_owner_ ? metrics_owner_->snapshot() : queue_metrics();
    }
 
-   size_t size() { return handlers_.size(); }
+   void reset_metrics()
+   {
+      std::lock_guard<std::mutex> g(producers_mtx_);
+      if( metrics_owner_ )
+         metrics_owner_->reset();
+   }
 
+   /**
+    * Executor running functions on the queue with one priority, e.g. for completion handlers of asio operations.
+    *
+    * Functions too large to be stored inline are boxed in memory of the allocator asio passes, which is the
+    * handler's associated allocator; for the default std::allocator the queue's recycling arena is used instead,
+    * so that steady state completions do not allocate. Work announced with on_work_started(), which asio does
+    * for every pending asynchronous operation whose handler uses the executor, is counted by outstanding_work().
+    * Only dispatch from a thread that executes the queue, as for add().
+    */
    class executor
    {
    public:
@@ -62,25 +880,32 @@ public:
       }
 
       template <typename Function, typename Allocator>
-      void dispatch(Function f, const Allocator&) const
+      void dispatch(Function f, const Allocator& a) const
       {
-         context_.add(priority_, std::move(f));
+         context_.add_allocated(priority_, std::move(f), a);
       }
 
       template <typename Function, typename Allocator>
-      void post(Function f, const Allocator&) const
+      void post(Function f, const Allocator& a) const
       {
-         context_.add(priority_, std::move(f));
+         context_.add_allocated(priority_, std::move(f), a);
       }
 
       template <typename Function, typename Allocator>
-      void defer(Function f, const Allocator&) const
+      void defer(Function f, const Allocator& a) const
+      {
+         context_.add_allocated(priority_, std::move(f), a);
+      }
+
+      void on_work_started() const noexcept
       {
-         context_.add(priority_, std::move(f));
+         context_.outstanding_work_.fetch_add(1, std::memory_order_relaxed);
       }
 
-      void on_work_started() const noexcept {}
-      void on_work_finished() const noexcept {}
+      void on_work_finished() const noexcept
+      {
+         context_.outstanding_work_.fetch_sub(1, std::memory_order_release);
+      }
 
       bool operator==(const executor& other) const noexcept
       {
@@ -105,25 +930,29 @@ public:
    }
 
 private:
-   class queued_handler_base
+   class queued_handler
    {
    public:
-      queued_handler_base( int p, size_t order )
+      queued_handler( int p, size_t order, impl::handler_function&& f )
             : priority_( p )
             , order_( order )
+            , function_( std::move(f) )
       {
       }
 
-      virtual ~queued_handler_base() = default;
+      void execute()
+      {
+         function_();
+      }
 
-      virtual void execute() = 0;
+      impl::handler_function release() { return std::move(function_); }
 
       int priority() const { return priority_; }
       // C++20
-      // friend std::weak_ordering operator<=>(const queued_handler_base&,
-      //                                       const queued_handler_base&) noexcept = default;
-      friend bool operator<(const queued_handler_base& a,
-                            const queued_handler_base& b) noexcept
+      // friend std::weak_ordering operator<=>(const queued_handler&,
+      //                                       const queued_handler&) noexcept = default;
+      friend bool operator<(const queued_handler& a,
+                            const queued_handler& b) noexcept
       {
          return std::tie( a.priority_, a.order_ ) < std::tie( b.priority_, b.order_ );
       }
@@ -131,38 +960,449 @@ private:
    private:
       int priority_;
       size_t order_;
+      impl::handler_function function_;
    };
 
-   template <typename Function>
-   class queued_handler : public queued_handler_base
+   struct overflow_node {
+      overflow_node*          next;
+      int                     priority;
+      impl::handler_function  function;
+   };
+
+   /// liveness of a producer thread, cleared when the thread exits so that its ring can be handed to another thread
+   struct producer_token {
+      std::atomic<bool> alive{true};
+   };
+
+   /**
+    * Single-producer / single-consumer ring owned by one posting thread. Once the ring is full the producer
+    * switches to its overflow list and keeps using it until the consumer has emptied it, which keeps
+    * handlers from one producer in FIFO order.
+    */
+   class producer_ring
    {
    public:
-      queued_handler(int p, size_t order, Function f)
-            : queued_handler_base( p, order )
-            , function_( std::move(f) )
+      static constexpr size_t capacity = 1024; // must be a power of 2
+
+      producer_ring(std::thread::id owner, std::shared_ptr<producer_token> token)
+            : owner_(owner), token_(std::move(token))
       {
       }
 
-      void execute() override
+      ~producer_ring()
       {
-         function_();
+         consume([](int, impl::handler_function&&) {});
+      }
+
+      bool try_push(int priority, impl::handler_function& f)
+      {
+         if( overflow_.load(std::memory_order_acquire) )
+            return false;
+         const size_t tail = tail_.load(std::memory_order_relaxed);
+         if( tail - cached_head_ == capacity ) {
+            cached_head_ = head_.load(std::memory_order_acquire);
+            if( tail - cached_head_ == capacity )
+               return false;
+         }
+         slot& s = slots_[tail & (capacity - 1)];
+         s.priority = priority;
+         new (&s.storage) impl::handler_function(std::move(f));
+         tail_.store(tail + 1, std::memory_order_release);
+         return true;
+      }
+
+      template <typename Consumer>
+      void consume(Consumer&& consumer)
+      {
+         size_t head = head_.load(std::memory_order_relaxed);
+         const size_t tail = tail_.load(std::memory_order_acquire);
+         for( ; head != tail; ++head ) {
+            slot& s = slots_[head & (capacity - 1)];
+            impl::handler_function& f = *reinterpret_cast<impl::handler_function*>(&s.storage);
+            consumer(s.priority, std::move(f));
+            f.~handler_function();
+         }
+         head_.store(head, std::memory_order_release);
+      }
+
+      /// nothing left for the consumer, only meaningful while no producer pushes
+      bool empty() const
+      {
+         return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire) &&
+                !overflow_.load(std::memory_order_acquire);
       }
 
    private:
-      Function function_;
+      friend class execution_priority_queue;
+
+      struct slot {
+         int priority;
+         std::aligned_storage_t<sizeof(impl::handler_function), alignof(impl::handler_function)> storage;
+      };
+
+      static constexpr size_t cache_line = 64;
+
+      // head_ and tail_ are kept on separate cache lines; padding instead of alignas() as over-aligned
+      // new requires C++17
+      std::thread::id                 owner_;             // owner_ and token_ guarded by producers_mtx_
+      std::shared_ptr<producer_token> token_;
+      char                            pad0_[cache_line];
+      std::atomic<size_t>             head_{0};           // written by consumer
+      char                            pad1_[cache_line - sizeof(std::atomic<size_t>)];
+      std::atomic<size_t>             tail_{0};           // written by producer
+      size_t                          cached_head_ = 0;   // producer's last view of head_
+      std::atomic<overflow_node*>     overflow_{nullptr}; // most recent first
+      slot                            slots_[capacity];
    };
 
-   struct deref_less
+   static constexpr size_t max_producers = 64;
+
+   /// the handler_function of a function, boxed in memory of alloc if it does not fit inline
+   template <typename Function, typename Allocator = std::allocator<void>>
+   impl::handler_function make_function(int priority, const char* tag, Function&& function, const Allocator& alloc = Allocator())
    {
-      template<typename Pointer>
-      bool operator()(const Pointer& a, const Pointer& b) noexcept(noexcept(*a < *b))
-      {
-         return *a < *b;
+      if( handler_watchdog::enabled() )
+         return make_traced_function(priority, tag, impl::watched_handler<std::decay_t<Function>>{std::forward<Function>(function), tag, priority}, alloc);
+      return make_traced_function(priority, tag, std::forward<Function>(function), alloc);
+   }
+
+   template <typename Function, typename Allocator>
+   impl::handler_function make_traced_function(int priority, const char* tag, Function&& function, const Allocator& alloc)
+   {
+      if( trace_recorder::enabled() ) {
+         const uint64_t id = trace_recorder::instance().record(trace_recorder::enqueue, tag, priority);
+         return make_measured_function(priority, tag,
+                                       impl::traced_handler<std::decay_t<Function>>{std::forward<Function>(function), tag, priority, id}, alloc);
       }
-   };
+      return make_measured_function(priority, tag, std::forward<Function>(function), alloc);
+   }
+
+   template <typename Function, typename Allocator>
+   impl::handler_function make_measured_function(int priority, const char* tag, Function&& function, const Allocator& alloc)
+   {
+      using F = std::decay_t<Function>;
+      // the recorder is published before the flag is first set, and then kept
+      impl::metrics_recorder* recorder = metrics_.load(std::memory_order_acquire);
+      if( recorder && metrics_enabled_.load(std::memory_order_relaxed) ) {
+         return box_function(impl::instrumented_handler<F>{std::forward<Function>(function), recorder, tag, priority,
+                                                           std::chrono::steady_clock::now()}, alloc);
+      }
+      // an already type-erased handler_function is moved as is
+      if( std::is_same<F, impl::handler_function>::value )
+         return impl::handler_function(std::forward<Function>(function));
+      return box_function(std::forward<Function>(function), alloc);
+   }
+
+   template <typename Function, typename T>
+   impl::handler_function box_function(Function&& function, const std::allocator<T>&)
+   {
+      if( !impl::handler_function::fits_inline<std::decay_t<Function>>::value )
+         ++heap_allocations_;
+      return impl::handler_function(std::forward<Function>(function));
+   }
+
+   /// an arena_allocator counts its own heap allocations, memory of other allocators is not counted
+   template <typename Function, typename Allocator>
+   impl::handler_function box_function(Function&& function, const Allocator& alloc)
+   {
+      return impl::handler_function(std::allocator_arg, alloc, std::forward<Function>(function));
+   }
+
+   /**
+    * add() for the executor, handlers too large to be stored inline are boxed in memory of alloc. The default
+    * allocator of asio handlers is replaced by the queue's recycling arena.
+    */
+   template <typename Function, typename Allocator>
+   void add_allocated(int priority, Function&& function, const Allocator& alloc)
+   {
+      impl::handler_function f = make_function(priority, nullptr, std::forward<Function>(function), handler_allocator(alloc));
+      auto lock = consumer_lock();
+      push(priority, std::move(f));
+   }
+
+   template <typename T>
+   impl::arena_allocator<void> handler_allocator(const std::allocator<T>&) { return impl::arena_allocator<void>(arena_); }
+
+   template <typename Allocator>
+   const Allocator& handler_allocator(const Allocator& alloc) { return alloc; }
+
+   void record_depth()
+   {
+      impl::metrics_recorder* recorder = metrics_.load(std::memory_order_acquire);
+      if( recorder && metrics_enabled_.load(std::memory_order_relaxed) )
+         recorder->record_depth(size_);
+   }
+
+   /// locks the consumer side, only when multi-threaded
+   std::unique_lock<std::mutex> consumer_lock()
+   {
+      return multi_threaded_.load(std::memory_order_acquire) ? std::unique_lock<std::mutex>(consumer_mtx_) : std::unique_lock<std::mutex>();
+   }
+
+   void drain_ingress_locked()
+   {
+      drain_pending_.store(false, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+
+      const size_t n = num_producers_.load(std::memory_order_acquire);
+      for( size_t i = 0; i < n; ++i ) {
+         producer_ring* ring = producers_[i].load(std::memory_order_relaxed);
+         // anything in a ring's overflow list was pushed after everything in the ring itself
+         ring->consume([this](int priority, impl::handler_function&& f) { push(priority, std::move(f)); });
+         drain_overflow(ring->overflow_);
+      }
+      drain_overflow(overflow_);
+   }
+
+   void push(int priority, impl::handler_function&& f)
+   {
+      if( idle_workers_.load(std::memory_order_relaxed) )
+         workers_cv_.notify_one();
+      ++size_;
+      if( scheduling_ != scheduling::binary_heap ) {
+         size_t b = find_bucket(priority);
+         if( b != max_buckets ) {
+            if( buckets_[b].emplace_back(priority, --order_, std::move(f)) )
+               ++heap_allocations_;
+            non_empty_buckets_ |= uint32_t(1) << b;
+            return;
+         }
+      }
+      if( handlers_.size() == handlers_.capacity() )
+         ++heap_allocations_;
+      handlers_.emplace_back(priority, --order_, std::move(f));
+      std::push_heap(handlers_.begin(), handlers_.end());
+   }
+
+   int peek_priority()
+   {
+      const size_t b = select_bucket();
+      return b != max_buckets ? bucket_priorities_[b] : handlers_.front().priority();
+   }
 
-   std::priority_queue<std::unique_ptr<queued_handler_base>, std::deque<std::unique_ptr<queued_handler_base>>, deref_less> handlers_;
+   /// the bucket pop() takes the next handler from, max_buckets for the heap
+   size_t select_bucket()
+   {
+      if( !non_empty_buckets_ )
+         return max_buckets;
+      // buckets are sorted by descending priority, so the lowest set bit is the highest non-empty bucket
+      size_t b = lowest_bit(non_empty_buckets_);
+      if( !handlers_.empty() && bucket_priorities_[b] < handlers_.front().priority() )
+         b = max_buckets;
+      if( scheduling_ == scheduling::bucketed_fair ) {
+         for( uint32_t m = non_empty_buckets_; m; m &= m - 1 ) {
+            const size_t i = lowest_bit(m);
+            if( i != b && passed_over_[i] >= starvation_limit_ )
+               return i;
+         }
+      }
+      return b;
+   }
+
+   queued_handler pop()
+   {
+      --size_;
+      const size_t b = select_bucket();
+      if( scheduling_ == scheduling::bucketed_fair ) {
+         for( uint32_t m = non_empty_buckets_; m; m &= m - 1 )
+            ++passed_over_[lowest_bit(m)];
+         if( b != max_buckets )
+            passed_over_[b] = 0;
+      }
+      if( b != max_buckets ) {
+         queued_handler handler = buckets_[b].pop_front();
+         if( buckets_[b].empty() ) {
+            non_empty_buckets_ &= ~(uint32_t(1) << b);
+            passed_over_[b] = 0;
+         }
+         return handler;
+      }
+      std::pop_heap(handlers_.begin(), handlers_.end());
+      queued_handler handler = std::move(handlers_.back());
+      handlers_.pop_back();
+      return handler;
+   }
+
+   /// index of the bucket for priority, creating it if needed; max_buckets if priority has to use the heap
+   size_t find_bucket(int priority)
+   {
+      size_t i = 0;
+      for( ; i < num_buckets_ && bucket_priorities_[i] > priority; ++i ) {}
+      if( i < num_buckets_ && bucket_priorities_[i] == priority )
+         return i;
+      // priorities only reach the heap once every bucket is taken, so a priority is never split between both
+      if( num_buckets_ == max_buckets )
+         return max_buckets;
+
+      // insert a new bucket at i, shifting lower priority buckets (and their non-empty bits) down by one
+      for( size_t j = num_buckets_; j > i; --j ) {
+         bucket_priorities_[j] = bucket_priorities_[j - 1];
+         passed_over_[j] = passed_over_[j - 1];
+         buckets_[j] = std::move(buckets_[j - 1]);
+      }
+      passed_over_[i] = 0;
+      const uint32_t below = non_empty_buckets_ & ~((uint32_t(1) << i) - 1);
+      non_empty_buckets_ = (non_empty_buckets_ & ((uint32_t(1) << i) - 1)) | (below << 1);
+      bucket_priorities_[i] = priority;
+      ++num_buckets_;
+      return i;
+   }
+
+   static size_t lowest_bit(uint32_t v)
+   {
+#if defined(__GNUC__) || defined(__clang__)
+      return __builtin_ctz(v);
+#else
+      size_t i = 0;
+      while( !(v & 1) ) { v >>= 1; ++i; }
+      return i;
+#endif
+   }
+
+   void drain_overflow(std::atomic<overflow_node*>& list)
+   {
+      if( !list.load(std::memory_order_relaxed) )
+         return;
+      overflow_node* node = list.exchange(nullptr, std::memory_order_acquire);
+      // overflow list is a LIFO stack, reverse it to restore posting order
+      overflow_node* fifo = nullptr;
+      while( node ) {
+         overflow_node* next = node->next;
+         node->next = fifo;
+         fifo = node;
+         node = next;
+      }
+      while( fifo ) {
+         std::unique_ptr<overflow_node> n(fifo);
+         fifo = fifo->next;
+         push(n->priority, std::move(n->function));
+      }
+   }
+
+   static void free_overflow(overflow_node* node)
+   {
+      while( node ) {
+         std::unique_ptr<overflow_node> n(node);
+         node = node->next;
+      }
+   }
+
+   /// ring of the calling thread, nullptr if all producer slots are taken
+   producer_ring* local_ring()
+   {
+      struct cached_ring {
+         uint64_t       queue_id = 0;
+         producer_ring* ring = nullptr;
+         uint32_t       retry_in = 0; ///< while ring is nullptr, adds until registering is tried again
+      };
+      // a thread posting to several queues keeps the ring of each, up to cached_rings of them
+      constexpr size_t cached_rings = 4;
+      // registering locks producers_mtx_ and scans every ring, so a thread without one only retries now and then
+      constexpr uint32_t retry_interval = 256;
+      static thread_local std::array<cached_ring, cached_rings> cache;
+      static thread_local size_t next_evicted = 0;
+      for( cached_ring& c : cache ) {
+         if( c.queue_id == queue_id_ ) {
+            // the ring of a thread that exited since may have become free
+            if( !c.ring && --c.retry_in == 0 ) {
+               c.ring = register_producer();
+               c.retry_in = retry_interval;
+            }
+            return c.ring;
+         }
+      }
+      cached_ring& c = cache[next_evicted++ % cached_rings];
+      c = cached_ring{queue_id_, register_producer(), retry_interval};
+      return c.ring;
+   }
+
+   /// token of the calling thread, cleared when it exits
+   static const std::shared_ptr<producer_token>& thread_token()
+   {
+      struct holder {
+         std::shared_ptr<producer_token> token = std::make_shared<producer_token>();
+         ~holder() { token->alive.store(false, std::memory_order_release); }
+      };
+      static thread_local holder h;
+      return h.token;
+   }
+
+   producer_ring* register_producer()
+   {
+      std::lock_guard<std::mutex> g(producers_mtx_);
+      const auto id = std::this_thread::get_id();
+      const size_t n = num_producers_.load(std::memory_order_relaxed);
+      producer_ring* orphan = nullptr;
+      bool orphan_empty = false;
+      for( size_t i = 0; i < n; ++i ) {
+         producer_ring* ring = producers_[i].load(std::memory_order_relaxed);
+         if( !ring->token_->alive.load(std::memory_order_acquire) ) {
+            const bool empty = ring->empty();
+            if( !orphan || (empty && !orphan_empty) ) {
+               orphan = ring;
+               orphan_empty = empty;
+            }
+         } else if( ring->owner_ == id ) {
+            return ring;
+         }
+      }
+      // prefer the drained ring of a thread that exited, then a new ring, then any ring of a thread that exited
+      if( orphan && (orphan_empty || n == max_producers) ) {
+         // the consumer still drains what the previous owner pushed
+         orphan->owner_ = id;
+         orphan->token_ = thread_token();
+         orphan->cached_head_ = orphan->head_.load(std::memory_order_acquire);
+         return orphan;
+      }
+      if( n == max_producers )
+         return nullptr;
+      rings_.emplace_back(new producer_ring(id, thread_token()));
+      ++heap_allocations_;
+      producers_[n].store(rings_.back().get(), std::memory_order_relaxed);
+      num_producers_.store(n + 1, std::memory_order_release);
+      return rings_.back().get();
+   }
+
+   static uint64_t next_queue_id()
+   {
+      static std::atomic<uint64_t> id{0};
+      return ++id;
+   }
+
+   // boxes functions run by an executor, declared first as it has to outlive the queued handlers
+   impl::handler_arena         arena_{heap_allocations_};
+   std::vector<queued_handler> handlers_; // binary heap, highest (priority, order) at the front
    std::size_t order_ = std::numeric_limits<size_t>::max(); // to maintain FIFO ordering in queue within priority
+   std::size_t size_ = 0;
+   scheduling  scheduling_ = scheduling::binary_heap;
+
+   // scheduling::bucketed state, buckets sorted by descending priority
+   std::array<impl::ring_buffer<queued_handler>, max_buckets> buckets_;
+   std::array<int, max_buckets>                               bucket_priorities_{};
+   size_t                                                     num_buckets_ = 0;
+   uint32_t                                                   non_empty_buckets_ = 0; // bit i set if buckets_[i] is non-empty
+   std::array<uint32_t, max_buckets>                          passed_over_{};         // bucketed_fair: executions of other handlers while non-empty
+   uint32_t                                                   starvation_limit_ = 16;
+
+   const uint64_t                                        queue_id_;
+   std::mutex                                            producers_mtx_;
+   std::vector<std::unique_ptr<producer_ring>>           rings_;
+   std::array<std::atomic<producer_ring*>, max_producers> producers_{};
+   std::atomic<size_t>                                   num_producers_{0};
+   std::atomic<overflow_node*>                           overflow_{nullptr}; // producers without a ring
+   std::atomic<bool>                                     drain_pending_{false};
+   std::atomic<uint64_t>                                 heap_allocations_{0};
+   std::atomic<size_t>                                   outstanding_work_{0};
+   std::atomic<bool>                                     metrics_enabled_{false};
+   std::unique_ptr<impl::metrics_recorder>               metrics_owner_; // created on first enable, kept until destroyed
+   std::atomic<impl::metrics_recorder*>                  metrics_{nullptr}; // metrics_owner_, published for the handler paths
+
+   // set_multi_threaded() / run_worker() state
+   std::atomic<bool>                                     multi_threaded_{false};
+   std::mutex                                            consumer_mtx_;
+   std::condition_variable                               workers_cv_;
+   std::atomic<size_t>                                   idle_workers_{0};
+   bool                                                  stop_workers_ = false;
 };
 
 } // appbase
@@ -0,0 +1,307 @@
+#pragma once
+
+#include <boost/signals2.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <vector>
+
+namespace appbase {
+
+   namespace impl {
+      struct flat_slot_base {
+         std::atomic<bool> connected{true};
+      };
+
+      class flat_signal_state_base {
+         public:
+            virtual ~flat_signal_state_base() = default;
+            virtual void disconnect(const flat_slot_base* slot) = 0;
+      };
+
+      /// how each slot receives an argument of type A: by lvalue unless the signature asks for an rvalue reference
+      template<typename A>
+      using flat_slot_arg_t = std::conditional_t<std::is_rvalue_reference<A>::value, A, std::add_lvalue_reference_t<A>>;
+   }
+
+   /**
+    * Connection to a @ref flat_signal, mirrors the subset of boost::signals2::connection used by appbase
+    */
+   class flat_connection {
+      public:
+         flat_connection() = default;
+
+         bool connected() const {
+            auto slot = _slot.lock();
+            return slot && slot->connected.load(std::memory_order_relaxed);
+         }
+
+         void disconnect() {
+            auto signal = _signal.lock();
+            auto slot = _slot.lock();
+            if( signal && slot )
+               signal->disconnect(slot.get());
+         }
+
+      private:
+         flat_connection(std::weak_ptr<impl::flat_signal_state_base> signal, std::weak_ptr<impl::flat_slot_base> slot)
+         :_signal(std::move(signal)), _slot(std::move(slot))
+         {}
+
+         std::weak_ptr<impl::flat_signal_state_base> _signal;
+         std::weak_ptr<impl::flat_slot_base>         _slot;
+
+         template<typename Signature, typename Combiner>
+         friend class flat_signal;
+   };
+
+   template<typename Signature, typename Combiner>
+   class flat_signal;
+
+   /**
+    * A low overhead replacement for the parts of boost::signals2::signal used by channels and methods.
+    *
+    * Slots are kept in an immutable flat vector. connect() and disconnect() build a new vector under a mutex and
+    * publish it with a single atomic store, calls only read the current vector: a call costs an atomic
+    * increment/decrement of the reader count and one indirect call per slot. Replaced vectors are freed
+    * once no call is in progress, so slots may connect or disconnect from within a call.
+    *
+    * Slots are called in the same order as boost::signals2: grouped slots by ascending group, then ungrouped
+    * slots, each in connection order. A slot disconnected during a call is not called by the remainder of that call.
+    * The Combiner is invoked with a pair of input iterators whose dereference calls the slot, exactly like
+    * boost::signals2 combiners.
+    */
+   template<typename Ret, typename... Args, typename Combiner>
+   class flat_signal<Ret(Args...), Combiner> {
+      private:
+         using function_type = std::function<Ret(Args...)>;
+
+         struct slot : impl::flat_slot_base {
+            slot(std::shared_ptr<const function_type> fn, bool grouped, int group)
+            :fn(std::move(fn)), grouped(grouped), group(group)
+            {}
+
+            std::shared_ptr<const function_type> fn; ///< may be shared with the owner of the slot, see connect()
+            bool                                 grouped;
+            int                                  group;
+         };
+         using slot_list = std::vector<std::shared_ptr<slot>>;
+         using arg_tuple = std::tuple<std::add_lvalue_reference_t<Args>...>;
+
+         class state : public impl::flat_signal_state_base {
+            public:
+               state() : current(new slot_list()) {}
+
+               ~state() {
+                  delete current.load();
+                  for( auto list : retired )
+                     delete list;
+               }
+
+               void disconnect(const impl::flat_slot_base* s) override {
+                  std::lock_guard<std::mutex> g(mtx);
+                  const slot_list* old = current.load(std::memory_order_relaxed);
+                  auto updated = std::make_unique<slot_list>();
+                  updated->reserve(old->size());
+                  for( const auto& entry : *old ) {
+                     if( entry.get() == s )
+                        entry->connected.store(false, std::memory_order_relaxed);
+                     else
+                        updated->push_back(entry);
+                  }
+                  replace_locked(updated.release());
+               }
+
+               /// publish list as the current slot list, retiring the previous one; must hold mtx
+               void replace_locked(const slot_list* list) {
+                  retired.push_back(current.load(std::memory_order_relaxed));
+                  has_retired.store(true);
+                  current.store(list);
+                  reclaim_locked();
+               }
+
+               void reclaim_locked() {
+                  if( readers.load() != 0 )
+                     return;
+                  for( auto list : retired )
+                     delete list;
+                  retired.clear();
+                  has_retired.store(false);
+               }
+
+               void reclaim() {
+                  std::lock_guard<std::mutex> g(mtx);
+                  reclaim_locked();
+               }
+
+               std::mutex                     mtx;      ///< serializes writers
+               std::atomic<const slot_list*>  current;
+               std::atomic<size_t>            readers{0};
+               std::vector<const slot_list*>  retired;  ///< replaced lists that calls in progress may still be using
+               std::atomic<bool>              has_retired{false};
+         };
+
+         /// holds the current slot list alive for the duration of a call
+         class read_guard {
+            public:
+               explicit read_guard(state& s) : _state(s) {
+                  ++_state.readers;
+                  list = _state.current.load();
+               }
+               ~read_guard() {
+                  if( --_state.readers == 0 && _state.has_retired.load() )
+                     _state.reclaim();
+               }
+
+               const slot_list* list;
+
+            private:
+               state& _state;
+         };
+
+      public:
+         using result_type = typename Combiner::result_type;
+         using connection  = flat_connection;
+
+         /**
+          * Input iterator handed to the Combiner, dereferencing it calls the slot
+          */
+         class slot_call_iterator {
+            public:
+               slot_call_iterator(typename slot_list::const_iterator it, typename slot_list::const_iterator end, arg_tuple* args)
+               :_it(it), _end(end), _args(args)
+               {
+                  skip_disconnected();
+               }
+
+               Ret operator*() const {
+                  return call(std::index_sequence_for<Args...>());
+               }
+
+               slot_call_iterator& operator++() {
+                  ++_it;
+                  skip_disconnected();
+                  return *this;
+               }
+
+               bool operator==(const slot_call_iterator& other) const { return _it == other._it; }
+               bool operator!=(const slot_call_iterator& other) const { return _it != other._it; }
+
+            private:
+               template<size_t... I>
+               Ret call(std::index_sequence<I...>) const {
+                  return (*(*_it)->fn)(static_cast<impl::flat_slot_arg_t<Args>>(std::get<I>(*_args))...);
+               }
+
+               void skip_disconnected() {
+                  while( _it != _end && !(*_it)->connected.load(std::memory_order_relaxed) )
+                     ++_it;
+               }
+
+               typename slot_list::const_iterator _it;
+               typename slot_list::const_iterator _end;
+               arg_tuple*                         _args;
+         };
+
+         flat_signal() : _state(std::make_shared<state>()) {}
+         flat_signal(const flat_signal&) = delete;
+         flat_signal& operator=(const flat_signal&) = delete;
+
+         result_type operator()(Args... args) {
+            read_guard g(*_state);
+            arg_tuple t(args...);
+            return _combiner(slot_call_iterator(g.list->begin(), g.list->end(), &t),
+                             slot_call_iterator(g.list->end(), g.list->end(), &t));
+         }
+
+         /**
+          * connect an ungrouped slot, called after all grouped slots
+          */
+         template<typename F>
+         connection connect(F&& f) {
+            return insert(std::make_shared<slot>(std::make_shared<const function_type>(std::forward<F>(f)), false, 0));
+         }
+
+         /**
+          * connect a slot to group, groups are called in ascending order
+          */
+         template<typename F>
+         connection connect(int group, F&& f) {
+            return insert(std::make_shared<slot>(std::make_shared<const function_type>(std::forward<F>(f)), true, group));
+         }
+
+         /**
+          * connect a function the caller keeps a reference to, the slot shares ownership of it instead of copying it
+          */
+         connection connect(int group, std::shared_ptr<const function_type> fn) {
+            return insert(std::make_shared<slot>(std::move(fn), true, group));
+         }
+
+         size_t num_slots() const {
+            read_guard g(*_state);
+            size_t n = 0;
+            for( const auto& s : *g.list )
+               n += s->connected.load(std::memory_order_relaxed);
+            return n;
+         }
+
+         bool empty() const { return num_slots() == 0; }
+
+         void set_combiner(const Combiner& combiner) { _combiner = combiner; }
+
+      private:
+         connection insert(std::shared_ptr<slot> s) {
+            std::lock_guard<std::mutex> g(_state->mtx);
+            const slot_list* old = _state->current.load(std::memory_order_relaxed);
+            auto updated = std::make_unique<slot_list>(*old);
+            auto pos = updated->end();
+            if( s->grouped ) {
+               // after the last slot of the same or a lower group, before ungrouped slots
+               pos = std::find_if(updated->begin(), updated->end(), [&](const std::shared_ptr<slot>& other) {
+                  return !other->grouped || other->group > s->group;
+               });
+            }
+            updated->insert(pos, s);
+            _state->replace_locked(updated.release());
+            return connection(_state, s);
+         }
+
+         std::shared_ptr<state> _state;
+         Combiner               _combiner;
+   };
+
+   /**
+    * Dispatch backend for channels and methods using boost::signals2, the default
+    */
+   struct signals2_backend {
+      template<typename Signature, typename Combiner>
+      using signal = boost::signals2::signal<Signature, Combiner>;
+      using connection = boost::signals2::connection;
+
+      /// connect fn to signal in group without copying it, the slot expires with the last owner of fn
+      template<typename Signal, typename Function>
+      static connection connect_shared(Signal& signal, int group, const std::shared_ptr<Function>& fn) {
+         return signal.connect(group, typename Signal::slot_type(std::ref(*fn)).track_foreign(fn));
+      }
+   };
+
+   /**
+    * Dispatch backend for channels and methods using @ref flat_signal
+    */
+   struct flat_backend {
+      template<typename Signature, typename Combiner>
+      using signal = flat_signal<Signature, Combiner>;
+      using connection = flat_connection;
+
+      /// connect fn to signal in group without copying it, the slot shares ownership of fn
+      template<typename Signal, typename Function>
+      static connection connect_shared(Signal& signal, int group, const std::shared_ptr<Function>& fn) {
+         return signal.connect(group, std::shared_ptr<const Function>(fn));
+      }
+   };
+
+}
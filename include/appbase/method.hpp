@@ -4,11 +4,24 @@
 #pragma push_macro("N")
 #undef N
 
+#include <appbase/flat_signal.hpp>
+
 #include <boost/signals2.hpp>
 #include <boost/exception/diagnostic_information.hpp>
 
+#include <atomic>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <vector>
+
 namespace appbase {
 
+   class strand;
+
    using erased_method_ptr = std::unique_ptr<void, void(*)(void*)>;
 
    /**
@@ -135,51 +148,236 @@ namespace appbase {
    };
 
    namespace impl {
-      template<typename FunctionSig, typename DispatchPolicy>
+      /**
+       * The providers registered with a method, tracked next to the dispatch backend so that a method with a
+       * single provider can call it directly. A provider that was called directly is retired when it is
+       * unregistered and freed once no direct call is in progress, counted in the same way as @ref flat_signal
+       * counts its readers.
+       */
+      template<typename FunctionSig>
+      class provider_registry {
+         public:
+            using function_type = std::function<FunctionSig>;
+
+            /// holds the single provider, if there is one, alive for the duration of a direct call
+            class single_guard {
+               public:
+                  explicit single_guard(provider_registry& r) : _registry(r) {
+                     ++_registry._readers;
+                     provider = _registry._single.load();
+                  }
+                  ~single_guard() {
+                     if( --_registry._readers == 0 && _registry._has_retired.load() )
+                        _registry.reclaim();
+                  }
+                  single_guard(const single_guard&) = delete;
+                  single_guard& operator=(const single_guard&) = delete;
+
+                  const function_type* provider; ///< nullptr unless exactly one provider is registered
+
+               private:
+                  provider_registry& _registry;
+            };
+
+            uint64_t add(std::shared_ptr<function_type> provider) {
+               std::lock_guard<std::mutex> g(_mtx);
+               const uint64_t id = ++_next_id;
+               _providers.emplace(id, entry{std::move(provider), false});
+               update_single_locked();
+               return id;
+            }
+
+            /// whether a direct call is likely, the provider itself is only read through a single_guard
+            bool has_single() const { return _single.load(std::memory_order_relaxed) != nullptr; }
+
+            void remove(uint64_t id) {
+               std::lock_guard<std::mutex> g(_mtx);
+               auto itr = _providers.find(id);
+               if( itr == _providers.end() )
+                  return;
+               if( itr->second.direct ) {
+                  _retired.push_back(std::move(itr->second.provider));
+                  _has_retired.store(true);
+               }
+               _providers.erase(itr);
+               update_single_locked();
+               reclaim_locked();
+            }
+
+         private:
+            struct entry {
+               std::shared_ptr<function_type> provider;
+               bool                           direct; ///< has been the single provider
+            };
+
+            void update_single_locked() {
+               const function_type* single = nullptr;
+               if( _providers.size() == 1 ) {
+                  entry& e = _providers.begin()->second;
+                  e.direct = true;
+                  single = e.provider.get();
+               }
+               _single.store(single);
+            }
+
+            void reclaim_locked() {
+               if( _readers.load() != 0 )
+                  return;
+               _retired.clear();
+               _has_retired.store(false);
+            }
+
+            void reclaim() {
+               std::lock_guard<std::mutex> g(_mtx);
+               reclaim_locked();
+            }
+
+            std::mutex                                           _mtx;
+            std::map<uint64_t, entry>                            _providers;
+            std::vector<std::shared_ptr<function_type>>          _retired; ///< direct calls in progress may still use these
+            std::atomic<bool>                                    _has_retired{false};
+            std::atomic<size_t>                                  _readers{0};  ///< direct calls in progress
+            uint64_t                                             _next_id = 0;
+            std::atomic<const function_type*>                    _single{nullptr};
+      };
+
+      /**
+       * Input iterator over a single provider handed to the DispatchPolicy, dereferencing it calls the provider
+       */
+      template<typename Ret, typename... Args>
+      class single_provider_iterator {
+         public:
+            using arg_tuple = std::tuple<std::add_lvalue_reference_t<Args>...>;
+
+            single_provider_iterator(const std::function<Ret(Args...)>* provider, arg_tuple* args)
+            :_provider(provider), _args(args)
+            {}
+
+            Ret operator*() const {
+               return call(std::index_sequence_for<Args...>());
+            }
+
+            single_provider_iterator& operator++() {
+               _provider = nullptr;
+               return *this;
+            }
+
+            bool operator==(const single_provider_iterator& other) const { return _provider == other._provider; }
+            bool operator!=(const single_provider_iterator& other) const { return _provider != other._provider; }
+
+         private:
+            template<size_t... I>
+            Ret call(std::index_sequence<I...>) const {
+               return (*_provider)(static_cast<flat_slot_arg_t<Args>>(std::get<I>(*_args))...);
+            }
+
+            const std::function<Ret(Args...)>* _provider;
+            arg_tuple*                         _args;
+      };
+
+      template<typename FunctionSig, typename DispatchPolicy, typename Backend>
       class method_caller;
 
-      template<typename Ret, typename ...Args, typename DispatchPolicy>
-      class method_caller<Ret(Args...), DispatchPolicy> {
+      template<typename Ret, typename ...Args, typename DispatchPolicy, typename Backend>
+      class method_caller<Ret(Args...), DispatchPolicy, Backend> {
          public:
-            using signal_type = boost::signals2::signal<Ret(Args...), DispatchPolicy>;
+            using signal_type = typename Backend::template signal<Ret(Args...), DispatchPolicy>;
             using result_type = Ret;
 
             method_caller()
             {}
 
             /**
-             * call operator from boost::signals2
+             * call operator from the dispatch backend, or directly to the provider if there is only one
              *
              * @throws exception depending on the DispatchPolicy
              */
             Ret operator()(Args&&... args)
             {
+               if( _providers->has_single() ) {
+                  typename provider_registry<Ret(Args...)>::single_guard g(*_providers);
+                  if( g.provider ) {
+                     typename iterator::arg_tuple t(args...);
+                     return _policy(iterator(g.provider, &t), iterator(nullptr, &t));
+                  }
+               }
                return _signal(std::forward<Args>(args)...);
             }
 
-            signal_type _signal;
+            signal_type                                          _signal;
+            std::shared_ptr<provider_registry<Ret(Args...)>>    _providers = std::make_shared<provider_registry<Ret(Args...)>>();
+
+         private:
+            using iterator = single_provider_iterator<Ret, Args...>;
+
+            DispatchPolicy                                       _policy;
       };
 
-      template<typename ...Args, typename DispatchPolicy>
-      class method_caller<void(Args...), DispatchPolicy> {
+      template<typename ...Args, typename DispatchPolicy, typename Backend>
+      class method_caller<void(Args...), DispatchPolicy, Backend> {
          public:
-            using signal_type = boost::signals2::signal<void(Args...), DispatchPolicy>;
+            using signal_type = typename Backend::template signal<void(Args...), DispatchPolicy>;
             using result_type = void;
 
             method_caller()
             {}
 
             /**
-             * call operator from boost::signals2
+             * call operator from the dispatch backend, or directly to the provider if there is only one
              *
              * @throws exception depending on the DispatchPolicy
              */
             void operator()(Args&&... args)
             {
+               if( _providers->has_single() ) {
+                  typename provider_registry<void(Args...)>::single_guard g(*_providers);
+                  if( g.provider ) {
+                     typename iterator::arg_tuple t(args...);
+                     return _policy(iterator(g.provider, &t), iterator(nullptr, &t));
+                  }
+               }
                _signal(std::forward<Args>(args)...);
             }
 
-            signal_type _signal;
+            signal_type                                          _signal;
+            std::shared_ptr<provider_registry<void(Args...)>>    _providers = std::make_shared<provider_registry<void(Args...)>>();
+
+         private:
+            using iterator = single_provider_iterator<void, Args...>;
+
+            DispatchPolicy                                       _policy;
+      };
+
+      /**
+       * Handler running a method call with copies of its arguments and fulfilling the promise of call_async()
+       */
+      template<typename Method, typename Ret, typename... Args>
+      struct async_method_call {
+         Method*             method;
+         std::promise<Ret>   promise;
+         std::tuple<Args...> args;
+
+         void operator()()
+         {
+            try {
+               complete(std::index_sequence_for<Args...>(), std::is_void<Ret>());
+            } catch (...) {
+               promise.set_exception(std::current_exception());
+            }
+         }
+
+         template<size_t... I>
+         void complete(std::index_sequence<I...>, std::false_type)
+         {
+            promise.set_value((*method)(std::move(std::get<I>(args))...));
+         }
+
+         template<size_t... I>
+         void complete(std::index_sequence<I...>, std::true_type)
+         {
+            (*method)(std::move(std::get<I>(args))...);
+            promise.set_value();
+         }
       };
    }
 
@@ -192,10 +390,13 @@ namespace appbase {
     *
     * @tparam FunctionSig - the signature of the method (eg void(int, int))
     * @tparam DispatchPolicy - the policy for dispatching this method
+    * @tparam Backend - the dispatch backend, @ref signals2_backend or @ref flat_backend
     */
-   template<typename FunctionSig, typename DispatchPolicy>
-   class method final : public impl::method_caller<FunctionSig,DispatchPolicy> {
+   template<typename FunctionSig, typename DispatchPolicy, typename Backend = signals2_backend>
+   class method final : public impl::method_caller<FunctionSig,DispatchPolicy,Backend> {
       public:
+         using result_type = typename impl::method_caller<FunctionSig,DispatchPolicy,Backend>::result_type;
+
          /**
           * Type that represents a registered provider for a method allowing
           * for ownership via RAII and also explicit unregistered actions
@@ -211,6 +412,10 @@ namespace appbase {
                 * of this object expires
                 */
                void unregister() {
+                  if (auto providers = _providers.lock()) {
+                     providers->remove(_id);
+                     _providers.reset();
+                  }
                   if (_handle.connected()) {
                      _handle.disconnect();
                   }
@@ -226,17 +431,22 @@ namespace appbase {
                handle& operator= (const handle& ) = delete;
 
             private:
-               using handle_type = boost::signals2::connection;
-               handle_type _handle;
+               using handle_type = typename Backend::connection;
+               using registry_type = impl::provider_registry<FunctionSig>;
+               handle_type                  _handle;
+               std::weak_ptr<registry_type> _providers;
+               uint64_t                     _id = 0;
 
                /**
                 * Construct a handle from an internal represenation of a handle
-                * In this case a boost::signals2::connection
+                * In this case a connection of the dispatch backend
                 *
-                * @param _handle - the boost::signals2::connection to wrap
+                * @param _handle - the connection to wrap
+                * @param providers - the provider registry of the method
+                * @param id - the id of the provider in providers
                 */
-               handle(handle_type&& _handle)
-               :_handle(std::move(_handle))
+               handle(handle_type&& _handle, const std::shared_ptr<registry_type>& providers, uint64_t id)
+               :_handle(std::move(_handle)), _providers(providers), _id(id)
                {}
 
                friend class method;
@@ -251,9 +461,32 @@ namespace appbase {
           */
          template<typename T>
          handle register_provider(T provider, int priority = 0) {
-            return handle(this->_signal.connect(priority, provider));
+            // the backend and the single provider fast path share the provider, and with it any state it keeps
+            auto shared = std::make_shared<std::function<FunctionSig>>(std::move(provider));
+            auto connection = Backend::connect_shared(this->_signal, priority, shared);
+            const uint64_t id = this->_providers->add(std::move(shared));
+            return handle(std::move(connection), this->_providers, id);
          }
 
+         /**
+          * Call the method from a handler posted with given priority instead of on the calling thread, so that a
+          * slow provider does not hold up the caller and several calls can be in flight at once.
+          * The arguments are copied or moved into the handler. Safe to call from any thread.
+          *
+          * Waiting on the future from the thread running exec() deadlocks unless exec() runs more than one thread;
+          * if the application exits before the handler runs the future holds a std::future_error (broken_promise).
+          *
+          * @return future of the result, or of the exception the DispatchPolicy raised
+          */
+         template<typename... CallArgs>
+         std::future<result_type> call_async(int priority, CallArgs&&... args);
+
+         /**
+          * call_async() running the providers on strand s, for providers that serialize access to their state through it
+          */
+         template<typename... CallArgs>
+         std::future<result_type> call_async(strand& s, int priority, CallArgs&&... args);
+
       protected:
          method() = default;
          virtual ~method() = default;
@@ -296,15 +529,16 @@ namespace appbase {
     * @tparam Tag - API specific discriminator used to distinguish between otherwise identical method signatures
     * @tparam FunctionSig - the signature of the method
     * @tparam DispatchPolicy - dispatch policy that dictates how providers for a method are accessed defaults to @ref first_success_policy
+    * @tparam Backend - dispatch backend, @ref signals2_backend (default) or the lower overhead @ref flat_backend
     */
-   template< typename Tag, typename FunctionSig, template <typename> class DispatchPolicy = first_success_policy>
+   template< typename Tag, typename FunctionSig, template <typename> class DispatchPolicy = first_success_policy, typename Backend = signals2_backend>
    struct method_decl {
-      using method_type = method<FunctionSig, DispatchPolicy<FunctionSig>>;
+      using method_type = method<FunctionSig, DispatchPolicy<FunctionSig>, Backend>;
       using tag_type = Tag;
    };
 
-   template <typename Tag, typename FunctionSig, template <typename> class DispatchPolicy>
-   std::true_type is_method_decl_impl(const method_decl<Tag, FunctionSig, DispatchPolicy>*);
+   template <typename Tag, typename FunctionSig, template <typename> class DispatchPolicy, typename Backend>
+   std::true_type is_method_decl_impl(const method_decl<Tag, FunctionSig, DispatchPolicy, Backend>*);
 
    std::false_type is_method_decl_impl(...);
 
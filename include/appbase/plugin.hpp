@@ -1,6 +1,7 @@
 #pragma once
 #include <boost/program_options.hpp>
 #include <boost/preprocessor/seq/for_each.hpp>
+#include <functional>
 #include <string>
 #include <vector>
 #include <map>
@@ -40,8 +41,14 @@ namespace appbase {
          virtual void set_program_options( options_description& cli, options_description& cfg ) = 0;
          virtual void initialize(const variables_map& options) = 0;
          virtual void handle_sighup() = 0;
+         /// called by application::reload_config() with the options of this plugin whose value changed, an option
+         /// removed from the config file that has no default is present but empty
+         virtual void handle_config_changed(const variables_map& /*changed*/) {}
          virtual void startup() = 0;
          virtual void shutdown() = 0;
+
+         /// calls visitor with each plugin this plugin requires, used to schedule independent plugins concurrently
+         virtual void visit_dependencies( const std::function<void(abstract_plugin&)>& ) {}
    };
 
    template<typename Impl>
@@ -0,0 +1,338 @@
+#pragma once
+#include <appbase/application.hpp>
+
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/interprocess/shared_memory_object.hpp>
+#include <boost/throw_exception.hpp>
+
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace appbase {
+
+   /**
+    * How Data is copied into and out of a shared memory channel. Trivially copyable data is copied as is; for other
+    * types specialize shm_codec with the same members, e.g. to flat-serialize a struct with a string into its bytes.
+    */
+   template<typename Data, typename Enable = void>
+   struct shm_codec;
+
+   template<typename Data>
+   struct shm_codec<Data, std::enable_if_t<std::is_trivially_copyable<Data>::value>> {
+      static constexpr size_t max_size = sizeof(Data); ///< default max_message_size, optional for specializations
+
+      static size_t size(const Data&) { return sizeof(Data); }
+      static void   encode(const Data& data, char* out) { std::memcpy(out, &data, sizeof(Data)); }
+      static Data   decode(const char* in, size_t /*size*/) {
+         std::aligned_storage_t<sizeof(Data), alignof(Data)> storage;
+         std::memcpy(&storage, in, sizeof(Data));
+         return *reinterpret_cast<const Data*>(&storage);
+      }
+   };
+
+   struct shm_channel_options {
+      size_t                    capacity = 4096;         ///< messages the ring holds, rounded up to a power of 2
+      size_t                    max_message_size = 0;    ///< bytes per message, 0 for shm_codec<Data>::max_size
+      std::chrono::microseconds max_idle_sleep{1000};    ///< longest sleep of an idle reader between polls
+   };
+
+   namespace impl {
+      static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "shared memory channels need lock-free 64 bit atomics");
+
+      template<typename Codec, typename = void>
+      struct codec_max_size { static constexpr size_t value = 0; };
+      template<typename Codec>
+      struct codec_max_size<Codec, decltype(void(Codec::max_size))> { static constexpr size_t value = Codec::max_size; };
+
+      /**
+       * Bounded multi-producer ring of variable sized messages in a named shared memory segment, after
+       * D. Vyukov's bounded MPMC queue: every slot carries a sequence number telling producers and the consumer
+       * whether it is free or filled for a given position, so neither side takes a lock or enters the kernel.
+       *
+       * Any number of threads and processes may push. Only one thread, of one process, may pop. A producer that
+       * dies between reserving and filling a slot blocks the ring at that slot.
+       */
+      class shm_ring {
+         public:
+            /// attach to the segment of given name, creating it if it does not exist yet
+            shm_ring(const std::string& name, size_t capacity, size_t slot_size) {
+               namespace bip = boost::interprocess;
+               capacity = round_up_pow2(std::max<size_t>(capacity, 2));
+               _stride = (sizeof(slot) + slot_size + cache_line - 1) / cache_line * cache_line;
+               const size_t size = sizeof(header) + capacity * _stride;
+               try {
+                  bool created = true;
+                  bip::shared_memory_object shm;
+                  try {
+                     shm = bip::shared_memory_object(bip::create_only, name.c_str(), bip::read_write);
+                     shm.truncate(size);
+                  } catch( const bip::interprocess_exception& e ) {
+                     if( e.get_error_code() != bip::already_exists_error )
+                        throw;
+                     created = false;
+                     shm = bip::shared_memory_object(bip::open_only, name.c_str(), bip::read_write);
+                     // the creator may not have sized the segment yet
+                     bip::offset_t current = 0;
+                     for( int n = 0; (!shm.get_size(current) || current < bip::offset_t(sizeof(header))) && n < attach_polls; ++n )
+                        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                  }
+                  _region = bip::mapped_region(shm, bip::read_write);
+                  _header = static_cast<header*>(_region.get_address());
+                  if( created ) {
+                     new (_header) header{capacity, slot_size};
+                     for( size_t i = 0; i < capacity; ++i )
+                        new (slot_at(i)) slot{{i}, 0};
+                     _header->ready.store(magic, std::memory_order_release);
+                  } else {
+                     for( int n = 0; _header->ready.load(std::memory_order_acquire) != magic && n < attach_polls; ++n )
+                        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                  }
+               } catch( const bip::interprocess_exception& e ) {
+                  BOOST_THROW_EXCEPTION(std::runtime_error("Unable to open shared memory channel '" + name + "': " + e.what()));
+               }
+               if( _header->ready.load(std::memory_order_acquire) != magic )
+                  BOOST_THROW_EXCEPTION(std::runtime_error("Shared memory channel '" + name + "' was never initialized"));
+               if( _header->capacity != capacity || _header->slot_size != slot_size || _region.get_size() < size )
+                  BOOST_THROW_EXCEPTION(std::runtime_error("Shared memory channel '" + name + "' exists with capacity " + std::to_string(_header->capacity)
+                                                           + " and message size " + std::to_string(_header->slot_size) + ", expected "
+                                                           + std::to_string(capacity) + " and " + std::to_string(slot_size)));
+               _mask = capacity - 1;
+            }
+
+            /**
+             * Reserve a slot, call fill(char* out) to write the message into it and publish it
+             * @return false if the ring is full
+             */
+            template<typename Fill>
+            bool push(size_t size, Fill&& fill) {
+               uint64_t pos = _header->head.load(std::memory_order_relaxed);
+               slot* s;
+               while( true ) {
+                  s = slot_at(pos & _mask);
+                  const uint64_t seq = s->seq.load(std::memory_order_acquire);
+                  const int64_t diff = int64_t(seq - pos);
+                  if( diff == 0 ) {
+                     if( _header->head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed) )
+                        break;
+                  } else if( diff < 0 ) {
+                     return false;
+                  } else {
+                     pos = _header->head.load(std::memory_order_relaxed);
+                  }
+               }
+               s->size = uint32_t(size);
+               fill(s->data());
+               s->seq.store(pos + 1, std::memory_order_release);
+               return true;
+            }
+
+            /**
+             * Call read(const char* in, size_t size) with the oldest message and free its slot
+             * @return false if the ring is empty
+             */
+            template<typename Read>
+            bool pop(Read&& read) {
+               const uint64_t pos = _header->tail.load(std::memory_order_relaxed);
+               slot* s = slot_at(pos & _mask);
+               if( s->seq.load(std::memory_order_acquire) != pos + 1 )
+                  return false;
+               read(static_cast<const char*>(s->data()), size_t(s->size));
+               s->seq.store(pos + _mask + 1, std::memory_order_release);
+               _header->tail.store(pos + 1, std::memory_order_relaxed);
+               return true;
+            }
+
+            size_t capacity() const  { return _mask + 1; }
+            size_t slot_size() const { return _header->slot_size; }
+
+         private:
+            static constexpr uint64_t magic = 0x6170706261736501ull; ///< "appbase", layout version 1
+            static constexpr size_t   cache_line = 64;
+            static constexpr int      attach_polls = 1000;            ///< wait up to a second for the creator
+
+            struct header {
+               header(uint64_t capacity, uint64_t slot_size) : capacity(capacity), slot_size(slot_size) {}
+
+               std::atomic<uint64_t>                  ready{0};
+               const uint64_t                         capacity;
+               const uint64_t                         slot_size;
+               alignas(cache_line) std::atomic<uint64_t> head{0};   ///< next position to reserve
+               alignas(cache_line) std::atomic<uint64_t> tail{0};   ///< next position to read
+            };
+
+            struct slot {
+               std::atomic<uint64_t> seq;  ///< pos while free for position pos, pos + 1 once filled
+               uint32_t              size;
+
+               char* data() { return reinterpret_cast<char*>(this + 1); }
+            };
+
+            static size_t round_up_pow2(size_t n) {
+               size_t p = 1;
+               while( p < n )
+                  p <<= 1;
+               return p;
+            }
+
+            slot* slot_at(size_t index) const {
+               return reinterpret_cast<slot*>(reinterpret_cast<char*>(_header) + sizeof(header) + index * _stride);
+            }
+
+            boost::interprocess::mapped_region  _region;
+            header*                             _header = nullptr;
+            size_t                              _stride = 0;
+            size_t                              _mask = 0;
+      };
+
+      template<typename Data>
+      size_t shm_message_size(const shm_channel_options& options) {
+         const size_t size = options.max_message_size ? options.max_message_size : codec_max_size<shm_codec<Data>>::value;
+         if( !size )
+            BOOST_THROW_EXCEPTION(std::invalid_argument("shm_channel_options::max_message_size is required for data that is not trivially copyable"));
+         return size;
+      }
+   }
+
+   /**
+    * Name of the shared memory segment of a channel, derived from the tag of its channel_decl so that every
+    * process built with the same declaration finds the same segment
+    */
+   template<typename ChannelDecl>
+   std::string shm_channel_name() {
+      // through a pointer, tags are usually never defined
+      std::string name = "appbase." + boost::core::demangle(typeid(typename ChannelDecl::tag_type*).name());
+      if( !name.empty() && name.back() == '*' )
+         name.pop_back();
+      for( char& c : name ) {
+         if( !std::isalnum(static_cast<unsigned char>(c)) && c != '.' && c != '_' )
+            c = '_';
+      }
+      if( name.size() > 200 )
+         name = name.substr(0, 180) + "." + std::to_string(std::hash<std::string>()(name));
+      return name;
+   }
+
+   /**
+    * Publishing end of a channel between processes on one host. Messages go into a ring in shared memory, see
+    * @ref shm_channel_reader for the receiving end. Safe to use from any thread, and from several processes.
+    *
+    * The segment is created by whichever end opens it first and stays until remove() is called, so a restarted
+    * process picks up where it left off; both ends must use the same capacity and max_message_size.
+    */
+   template<typename ChannelDecl>
+   class shm_channel_writer {
+      public:
+         using data_type = typename ChannelDecl::channel_type::data_type;
+         using codec = shm_codec<data_type>;
+
+         explicit shm_channel_writer(const shm_channel_options& options = shm_channel_options())
+         : _ring(shm_channel_name<ChannelDecl>(), options.capacity, impl::shm_message_size<data_type>(options))
+         {}
+
+         /**
+          * Copy data into the ring, without a system call
+          * @return false if the ring is full and data was dropped
+          * @throws std::length_error if the encoded data is larger than max_message_size
+          */
+         bool publish(const data_type& data) {
+            const size_t size = codec::size(data);
+            if( size > _ring.slot_size() )
+               BOOST_THROW_EXCEPTION(std::length_error("Message of " + std::to_string(size) + " bytes exceeds the max_message_size of "
+                                                       + std::to_string(_ring.slot_size()) + " of shared memory channel " + shm_channel_name<ChannelDecl>()));
+            if( _ring.push(size, [&data](char* out) { codec::encode(data, out); }) )
+               return true;
+            _dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+         }
+
+         /// messages publish() dropped because the ring was full
+         uint64_t dropped() const { return _dropped.load(std::memory_order_relaxed); }
+
+         /// remove the segment; processes attached to it keep their mapping
+         static bool remove() { return boost::interprocess::shared_memory_object::remove(shm_channel_name<ChannelDecl>().c_str()); }
+
+      private:
+         impl::shm_ring         _ring;
+         std::atomic<uint64_t>  _dropped{0};
+   };
+
+   /**
+    * Receiving end of a channel between processes: a thread polls the shared memory ring and publishes what it
+    * takes, in batches, to app().get_channel<ChannelDecl>() with given priority, so that the subscribers of the
+    * local channel receive the data of the writers in other processes. Only one reader per channel and host.
+    *
+    * An idle reader spins briefly, then sleeps with a backoff of up to shm_channel_options::max_idle_sleep, which
+    * bounds the added latency of a message arriving on an idle channel. Construct on the application thread and
+    * destroy before exec() returns, e.g. in plugin_shutdown().
+    */
+   template<typename ChannelDecl>
+   class shm_channel_reader {
+      public:
+         using data_type = typename ChannelDecl::channel_type::data_type;
+         using codec = shm_codec<data_type>;
+
+         explicit shm_channel_reader(int priority, const shm_channel_options& options = shm_channel_options())
+         : _ring(shm_channel_name<ChannelDecl>(), options.capacity, impl::shm_message_size<data_type>(options))
+         , _channel(app().get_channel<ChannelDecl>())
+         , _priority(priority)
+         , _max_idle_sleep(std::max(options.max_idle_sleep, std::chrono::microseconds(1)))
+         , _thread([this]() { run(); })
+         {}
+
+         ~shm_channel_reader() {
+            _stop = true;
+            _thread.join();
+         }
+
+         shm_channel_reader(const shm_channel_reader&) = delete;
+         shm_channel_reader& operator=(const shm_channel_reader&) = delete;
+
+         /// messages taken from the ring and published to the local channel
+         uint64_t received() const { return _received.load(std::memory_order_relaxed); }
+
+      private:
+         static constexpr size_t max_batch = 256;
+         static constexpr int    idle_spins = 1000;
+
+         void run() {
+            std::vector<data_type> batch;
+            int idle = 0;
+            auto sleep = std::chrono::microseconds(1);
+            while( !_stop.load(std::memory_order_relaxed) ) {
+               while( batch.size() < max_batch && _ring.pop([&batch](const char* in, size_t size) { batch.push_back(codec::decode(in, size)); }) ) {}
+               if( !batch.empty() ) {
+                  _received.fetch_add(batch.size(), std::memory_order_relaxed);
+                  _channel.publish_batch(_priority, std::move(batch));
+                  batch = std::vector<data_type>();
+                  idle = 0;
+                  sleep = std::chrono::microseconds(1);
+                  continue;
+               }
+               if( ++idle < idle_spins ) {
+                  impl::cpu_relax();
+                  continue;
+               }
+               std::this_thread::sleep_for(sleep);
+               sleep = std::min(sleep * 2, _max_idle_sleep);
+            }
+         }
+
+         impl::shm_ring                         _ring;
+         typename ChannelDecl::channel_type&    _channel;
+         const int                              _priority;
+         const std::chrono::microseconds        _max_idle_sleep;
+         std::atomic<bool>                      _stop{false};
+         std::atomic<uint64_t>                  _received{0};
+         std::thread                            _thread; ///< last, started once everything it uses is constructed
+   };
+
+} // appbase
@@ -0,0 +1,57 @@
+#pragma once
+#include <appbase/execution_priority_queue.hpp>
+
+#include <algorithm>
+#include <mutex>
+#include <tuple>
+#include <vector>
+
+namespace appbase {
+
+   /**
+    * A strand serializes the handlers posted through it: no two of them ever run at the same time, even when
+    * application::exec() runs several threads. Handlers of one strand run in priority order relative to each
+    * other, and the strand is scheduled on the application queue at the priority of its highest pending handler.
+    *
+    * A plugin whose handlers are not thread-safe can own a strand and post all of its work through it.
+    * The strand must outlive every handler posted to it.
+    */
+   class strand final {
+      public:
+         strand() = default;
+         strand(const strand&) = delete;
+         strand& operator=(const strand&) = delete;
+
+         /**
+          * Post func to run on the strand with given priority. Safe to call from any thread.
+          *
+          * @param priority can be appbase::priority::* constants or any int, larger ints run first
+          * @param func function to run
+          */
+         template<typename Func>
+         void post(int priority, Func&& func);
+
+      private:
+         struct pending_handler {
+            int                    priority;
+            uint64_t               order;     ///< decreasing, so handlers of equal priority run in FIFO order
+            impl::handler_function function;
+
+            friend bool operator<(const pending_handler& a, const pending_handler& b) noexcept {
+               return std::tie( a.priority, a.order ) < std::tie( b.priority, b.order );
+            }
+         };
+
+         void schedule(int priority);
+         void run_next(uint64_t generation);
+
+         std::mutex                   _mtx;
+         std::vector<pending_handler> _pending;            ///< binary heap, instrumented only as the runner in the application queue
+         uint64_t                     _order = 0;
+         bool                         _running = false;    ///< a handler of this strand is executing
+         bool                         _scheduled = false;  ///< a live runner is waiting in the application queue
+         int                          _scheduled_priority = priority::lowest;
+         uint64_t                     _generation = 0;     ///< runners from older generations are stale and do nothing
+   };
+
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <boost/algorithm/string.hpp>
+#include <boost/throw_exception.hpp>
+
+#include <cstring>
+#include <fstream>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace appbase {
+
+   /**
+    * CPU affinity and scheduling policy of a thread, applied by the thread to itself
+    */
+   struct thread_placement {
+      enum class policy { unchanged, other, fifo, rr };
+
+      std::vector<int> cpus;                       ///< empty to leave the affinity unchanged
+      policy           sched_policy = policy::unchanged;
+      int              sched_priority = 0;         ///< 0 for the maximum priority of sched_policy
+
+      bool empty() const { return cpus.empty() && sched_policy == policy::unchanged; }
+
+      /**
+       * Parse a comma separated list of CPUs, CPU ranges and NUMA nodes, e.g. "0,2-3,node:1". A NUMA node
+       * stands for all of its CPUs as listed in /sys/devices/system/node.
+       * @throws std::runtime_error on a malformed list or an unknown NUMA node
+       */
+      static std::vector<int> parse_cpus(const std::string& spec) {
+         std::set<int> cpus;
+         std::vector<std::string> items;
+         boost::split(items, spec, boost::is_any_of(","));
+         for( std::string item : items ) {
+            boost::trim(item);
+            if( item.empty() )
+               continue;
+            if( boost::starts_with(item, "node:") ) {
+               const std::string path = "/sys/devices/system/node/node" + item.substr(5) + "/cpulist";
+               std::ifstream in(path);
+               std::string list;
+               if( item.size() == 5 || item.find_first_not_of("0123456789", 5) != std::string::npos || !std::getline(in, list) )
+                  BOOST_THROW_EXCEPTION(std::runtime_error("Unknown NUMA node '" + item + "', " + path + " is not readable"));
+               for( int cpu : parse_cpus(list) )
+                  cpus.insert(cpu);
+               continue;
+            }
+            const auto dash = item.find('-');
+            try {
+               size_t end = 0;
+               const int first = std::stoi(item.substr(0, dash), &end);
+               if( end != item.substr(0, dash).size() )
+                  throw std::invalid_argument(item);
+               const int last = dash == std::string::npos ? first : std::stoi(item.substr(dash + 1), &end);
+               if( dash != std::string::npos && end != item.size() - dash - 1 )
+                  throw std::invalid_argument(item);
+               if( first < 0 || last < first )
+                  throw std::invalid_argument(item);
+               for( int cpu = first; cpu <= last; ++cpu )
+                  cpus.insert(cpu);
+            } catch( const std::logic_error& ) {
+               BOOST_THROW_EXCEPTION(std::runtime_error("Invalid CPU '" + item + "' in CPU list '" + spec + "'"));
+            }
+         }
+         return std::vector<int>(cpus.begin(), cpus.end());
+      }
+
+      /**
+       * @param name - "other", "fifo" or "rr", empty to leave the policy unchanged
+       * @throws std::runtime_error on an unknown policy
+       */
+      static policy parse_policy(const std::string& name) {
+         if( name.empty() )
+            return policy::unchanged;
+         if( name == "other" )
+            return policy::other;
+         if( name == "fifo" )
+            return policy::fifo;
+         if( name == "rr" )
+            return policy::rr;
+         BOOST_THROW_EXCEPTION(std::runtime_error("Unknown scheduling policy '" + name + "', expected other, fifo or rr"));
+      }
+
+      /**
+       * Apply to the calling thread
+       * @return empty on success, otherwise what failed
+       */
+      std::string apply_to_current_thread() const {
+         if( empty() )
+            return {};
+#ifdef __linux__
+         if( !cpus.empty() ) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            for( int cpu : cpus ) {
+               if( cpu >= CPU_SETSIZE )
+                  return "CPU " + std::to_string(cpu) + " is out of range";
+               CPU_SET(cpu, &set);
+            }
+            if( int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set) )
+               return std::string("unable to set CPU affinity: ") + std::strerror(err);
+         }
+         if( sched_policy != policy::unchanged ) {
+            const int native = sched_policy == policy::fifo ? SCHED_FIFO : sched_policy == policy::rr ? SCHED_RR : SCHED_OTHER;
+            struct sched_param params{};
+            params.sched_priority = sched_priority ? sched_priority : sched_get_priority_max(native);
+            if( native == SCHED_OTHER )
+               params.sched_priority = 0;
+            if( int err = pthread_setschedparam(pthread_self(), native, &params) )
+               return "unable to set scheduling policy with priority " + std::to_string(params.sched_priority) + ": " + std::strerror(err);
+         }
+         return {};
+#else
+         return "thread placement is only supported on Linux";
+#endif
+      }
+   };
+
+}
@@ -0,0 +1,251 @@
+#pragma once
+#include <appbase/execution_priority_queue.hpp>
+
+#include <boost/exception/diagnostic_information.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace appbase {
+
+/**
+ * Work-stealing pool of threads running prioritized background handlers, for work that should not run on the
+ * thread executing the application queue.
+ *
+ * Every thread has its own queue ordered by priority, then FIFO. A handler posted from one of the pool's threads
+ * goes to that thread's queue, other posts are spread round-robin; a thread whose queue is empty takes the highest
+ * priority handler of another thread's queue. Priorities are therefore only ordered per queue, not across the pool.
+ *
+ * The threads are started by the first post(). Handlers still pending when the pool stops are destroyed without
+ * running, and posts after that are dropped.
+ */
+class thread_pool
+{
+public:
+   using exception_handler = std::function<void(std::exception_ptr)>;
+
+   thread_pool() = default;
+   thread_pool(const thread_pool&) = delete;
+   thread_pool& operator=(const thread_pool&) = delete;
+
+   ~thread_pool() { stop(); }
+
+   /**
+    * Set the number of threads and whether to pin them, only applies if the pool has not started yet
+    * @param threads - 0 for one thread per core but one, leaving a core to the thread running exec()
+    * @param pin - pin thread i to CPU i modulo the number of CPUs (Linux only)
+    */
+   void configure(size_t threads, bool pin)
+   {
+      std::lock_guard<std::mutex> g(start_mtx_);
+      if( started_.load() )
+         return;
+      requested_threads_ = threads;
+      pin_ = pin;
+   }
+
+   /**
+    * Called on the pool thread with the exception of a handler that threw; without one the exception is
+    * written to std::cerr. Set before the first post().
+    */
+   void set_exception_handler(exception_handler handler) { on_exception_ = std::move(handler); }
+
+   /**
+    * Post func to run on the pool with given priority. Safe to call from any thread.
+    */
+   template <typename Func>
+   void post(int priority, Func&& func)
+   {
+      if( !started_.load(std::memory_order_acquire) )
+         start();
+      if( stopping_.load() )
+         return;
+      impl::handler_function f(std::forward<Func>(func));
+      worker* local = local_worker();
+      worker& w = local && local->pool == this ? *local : *workers_[next_worker_++ % workers_.size()];
+      {
+         std::lock_guard<std::mutex> g(w.mtx);
+         if( stopping_.load(std::memory_order_relaxed) )
+            return;
+         w.handlers.push_back(entry{priority, --w.order, std::move(f)});
+         std::push_heap(w.handlers.begin(), w.handlers.end());
+      }
+      pending_.fetch_add(1);
+      if( idle_.load() ) {
+         std::lock_guard<std::mutex> g(sleep_mtx_);
+         sleep_cv_.notify_one();
+      }
+   }
+
+   /**
+    * Stop the threads once they finish the handler they are running and destroy the pending handlers
+    */
+   void stop()
+   {
+      std::lock_guard<std::mutex> g(start_mtx_);
+      if( stopping_.load() )
+         return;
+      {
+         std::lock_guard<std::mutex> sg(sleep_mtx_);
+         stopping_ = true;
+         sleep_cv_.notify_all();
+      }
+      // a post() racing with stop() may still be using workers_, which is therefore kept
+      for( auto& w : workers_ ) {
+         w->thread.join();
+         std::lock_guard<std::mutex> wg(w->mtx);
+         w->handlers.clear();
+      }
+      pending_ = 0;
+   }
+
+   /// number of threads, 0 until the first post()
+   size_t num_threads() const { return started_.load(std::memory_order_acquire) ? workers_.size() : 0; }
+
+   /// handlers a thread took from the queue of another thread
+   uint64_t steals() const { return steals_.load(); }
+
+private:
+   struct entry {
+      int                    priority;
+      uint64_t               order;
+      impl::handler_function function;
+
+      bool operator<(const entry& other) const
+      {
+         return std::tie(priority, order) < std::tie(other.priority, other.order);
+      }
+   };
+
+   struct worker {
+      explicit worker(thread_pool* pool) : pool(pool) {}
+
+      thread_pool*        pool;
+      std::mutex          mtx;
+      std::vector<entry>  handlers; ///< heap, highest priority first, FIFO within a priority
+      uint64_t            order = std::numeric_limits<uint64_t>::max();
+      std::thread         thread;
+   };
+
+   /// the worker running on the calling thread, of any pool; nullptr on other threads
+   static worker*& local_worker()
+   {
+      static thread_local worker* local = nullptr;
+      return local;
+   }
+
+   void start()
+   {
+      std::lock_guard<std::mutex> g(start_mtx_);
+      if( started_.load() || stopping_.load() )
+         return;
+      size_t threads = requested_threads_;
+      if( !threads )
+         threads = std::max<size_t>(std::thread::hardware_concurrency(), 2) - 1;
+      for( size_t i = 0; i < threads; ++i )
+         workers_.push_back(std::unique_ptr<worker>(new worker(this)));
+      for( size_t i = 0; i < threads; ++i ) {
+         workers_[i]->thread = std::thread([this, i]() { run(i); });
+         if( pin_ )
+            pin_thread(workers_[i]->thread, i);
+      }
+      started_.store(true, std::memory_order_release);
+   }
+
+   static void pin_thread(std::thread& t, size_t index)
+   {
+#ifdef __linux__
+      const size_t cpus = std::max(std::thread::hardware_concurrency(), 1u);
+      cpu_set_t set;
+      CPU_ZERO(&set);
+      CPU_SET(index % cpus, &set);
+      if( pthread_setaffinity_np(t.native_handle(), sizeof(set), &set) != 0 )
+         std::cerr << "APPBASE: Unable to pin background thread " << index << " to CPU " << index % cpus << std::endl;
+#else
+      (void)t;
+      (void)index;
+#endif
+   }
+
+   bool pop(worker& w, impl::handler_function& f)
+   {
+      std::lock_guard<std::mutex> g(w.mtx);
+      if( w.handlers.empty() )
+         return false;
+      std::pop_heap(w.handlers.begin(), w.handlers.end());
+      f = std::move(w.handlers.back().function);
+      w.handlers.pop_back();
+      pending_.fetch_sub(1);
+      return true;
+   }
+
+   bool next(size_t self, impl::handler_function& f)
+   {
+      if( pop(*workers_[self], f) )
+         return true;
+      for( size_t i = 1; i < workers_.size(); ++i ) {
+         if( pop(*workers_[(self + i) % workers_.size()], f) ) {
+            ++steals_;
+            return true;
+         }
+      }
+      return false;
+   }
+
+   void run(size_t self)
+   {
+      local_worker() = workers_[self].get();
+      impl::handler_function f;
+      while( !stopping_.load(std::memory_order_relaxed) ) {
+         if( next(self, f) ) {
+            try {
+               f();
+            } catch( ... ) {
+               if( on_exception_ )
+                  on_exception_(std::current_exception());
+               else
+                  std::cerr << "APPBASE: background handler threw: " << boost::current_exception_diagnostic_information() << std::endl;
+            }
+            f = impl::handler_function();
+            continue;
+         }
+         std::unique_lock<std::mutex> g(sleep_mtx_);
+         // announce before checking, a post() that misses the idle count is seen by the check
+         ++idle_;
+         sleep_cv_.wait(g, [this]() { return stopping_.load() || pending_.load() > 0; });
+         --idle_;
+      }
+   }
+
+   std::mutex                           start_mtx_;
+   std::atomic<bool>                    started_{false};
+   size_t                               requested_threads_ = 0;
+   bool                                 pin_ = false;
+   exception_handler                    on_exception_;
+   std::vector<std::unique_ptr<worker>> workers_;
+   std::atomic<size_t>                  next_worker_{0};
+   std::atomic<size_t>                  pending_{0}; ///< handlers in all queues
+   std::atomic<uint64_t>                steals_{0};
+
+   std::mutex                           sleep_mtx_;
+   std::condition_variable              sleep_cv_;
+   std::atomic<size_t>                  idle_{0};
+   std::atomic<bool>                    stopping_{false};
+};
+
+} // appbase
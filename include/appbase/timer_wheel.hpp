@@ -0,0 +1,318 @@
+#pragma once
+#include <appbase/execution_priority_queue.hpp>
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <memory>
+
+namespace appbase {
+
+/**
+ * Hierarchical timing wheel of prioritized handlers.
+ *
+ * Time is divided into ticks. Level 0 has one slot per tick for the next 256 ticks, each higher level has one
+ * slot per 256 slots of the level below; timers further out than all levels wait in an overflow list. Adding
+ * a timer and firing it are O(1), a timer moves down at most once per level as its deadline approaches, and
+ * advance() skips the ticks without timers. Timers with the same deadline tick fire in the order they were added.
+ * Timer nodes are recycled, so in steady state adding a timer does not allocate beyond what the handler itself
+ * needs.
+ *
+ * Not thread-safe.
+ */
+class timer_wheel
+{
+public:
+   using clock = std::chrono::steady_clock;
+
+   static constexpr size_t slot_bits = 8;
+   static constexpr size_t slots     = size_t(1) << slot_bits;
+   static constexpr size_t levels    = 4;
+
+   explicit timer_wheel(clock::duration tick = std::chrono::milliseconds(1), clock::time_point start = clock::now())
+         : tick_(std::max(tick, clock::duration(1))), start_(start)
+   {
+   }
+
+   timer_wheel(const timer_wheel&) = delete;
+   timer_wheel& operator=(const timer_wheel&) = delete;
+
+   ~timer_wheel()
+   {
+      clear();
+      while( free_ ) {
+         node* n = free_;
+         free_ = n->next;
+         delete n;
+      }
+   }
+
+   /**
+    * Add function to run at priority once deadline is reached, a deadline already reached fires on the next advance()
+    */
+   void add(clock::time_point deadline, int priority, impl::handler_function&& function)
+   {
+      node* n = free_;
+      if( n ) {
+         free_ = n->next;
+         n->next = nullptr;
+         n->priority = priority;
+         n->function = std::move(function);
+      } else {
+         n = new node{nullptr, 0, priority, std::move(function)};
+      }
+      // an empty wheel is not advanced, catch up so that the timer is placed relative to now
+      if( !size_ )
+         current_tick_ = std::max(current_tick_, elapsed_ticks(clock::now()));
+      n->tick = std::max(to_tick(deadline), current_tick_ + 1);
+      place(n);
+      ++size_;
+   }
+
+   /**
+    * Fire every timer whose deadline is at or before now, in deadline order, by calling on_expired(priority, function)
+    */
+   template <typename OnExpired>
+   void advance(clock::time_point now, OnExpired&& on_expired)
+   {
+      const uint64_t target = elapsed_ticks(now);
+      while( current_tick_ < target ) {
+         // jump over the ticks at which nothing fires or cascades
+         const uint64_t next = size_ ? next_work_tick() : std::numeric_limits<uint64_t>::max();
+         if( next > target ) {
+            current_tick_ = target;
+            break;
+         }
+         current_tick_ = next;
+         cascade();
+         list& due = wheel_[0][current_tick_ & (slots - 1)];
+         if( !due.head )
+            continue;
+         clear_bit(0, current_tick_ & (slots - 1));
+         node* n = due.head;
+         due = list();
+         while( n ) {
+            node* next = n->next;
+            --size_;
+            on_expired(n->priority, std::move(n->function));
+            recycle(n);
+            n = next;
+         }
+      }
+   }
+
+   /**
+    * Earliest time at which advance() may fire or move timers, time_point::max() if there are no timers
+    */
+   clock::time_point next_event() const
+   {
+      if( !size_ )
+         return clock::time_point::max();
+      return from_tick(next_work_tick());
+   }
+
+   size_t size() const { return size_; }
+   bool   empty() const { return size_ == 0; }
+
+   /// destroy every pending timer without running it
+   void clear()
+   {
+      for( auto& level : wheel_ ) {
+         for( auto& slot : level ) {
+            free_list(slot.head);
+            slot = list();
+         }
+      }
+      free_list(overflow_.head);
+      overflow_ = list();
+      bits_ = {};
+      size_ = 0;
+   }
+
+private:
+   struct node {
+      node*                  next;
+      uint64_t               tick;
+      int                    priority;
+      impl::handler_function function;
+   };
+
+   struct list {
+      node* head = nullptr;
+      node* tail = nullptr;
+
+      void push_front(node* n)
+      {
+         n->next = head;
+         head = n;
+         if( !tail )
+            tail = n;
+      }
+
+      void push_back(node* n)
+      {
+         n->next = nullptr;
+         if( tail )
+            tail->next = n;
+         else
+            head = n;
+         tail = n;
+      }
+   };
+
+   uint64_t to_tick(clock::time_point t) const
+   {
+      if( t <= start_ )
+         return 0;
+      // round up, a timer never fires before its deadline
+      return uint64_t((t - start_ + tick_ - clock::duration(1)) / tick_);
+   }
+
+   clock::time_point from_tick(uint64_t tick) const { return start_ + tick * tick_; }
+
+   /// number of whole ticks from start_ to t
+   uint64_t elapsed_ticks(clock::time_point t) const { return t < start_ ? 0 : uint64_t((t - start_) / tick_); }
+
+   /// first tick after current_tick_ at which a level 0 slot fires or a non-empty slot cascades, only if not empty
+   uint64_t next_work_tick() const
+   {
+      uint64_t next = std::numeric_limits<uint64_t>::max();
+      if( const size_t d = next_slot(0) )
+         next = current_tick_ + d;
+      // the slot of a higher level cascades at the first tick of its range
+      for( size_t level = 1; level < levels; ++level ) {
+         if( const size_t d = next_slot(level) ) {
+            const size_t shift = slot_bits * level;
+            next = std::min(next, ((current_tick_ >> shift) + d) << shift);
+         }
+      }
+      if( overflow_.head ) {
+         const size_t shift = slot_bits * levels;
+         next = std::min(next, ((current_tick_ >> shift) + 1) << shift);
+      }
+      return next;
+   }
+
+   /// number of slots from the slot of current_tick_ to the next non-empty slot of level, 1 to slots, 0 if it is empty
+   size_t next_slot(size_t level) const
+   {
+      constexpr size_t words = slots / 64;
+      const size_t first = ((current_tick_ >> (slot_bits * level)) + 1) & (slots - 1);
+      // the word of first is searched twice, from first up and after wrapping around below first
+      for( size_t i = 0; i <= words; ++i ) {
+         const size_t w = (first / 64 + i) % words;
+         uint64_t word = bits_[level][w];
+         if( i == 0 )
+            word &= ~uint64_t(0) << (first % 64);
+         else if( i == words )
+            word &= (uint64_t(1) << (first % 64)) - 1;
+         if( word ) {
+            const size_t slot = w * 64 + lowest_bit(word);
+            return 1 + ((slot - first) & (slots - 1));
+         }
+      }
+      return 0;
+   }
+
+   static size_t lowest_bit(uint64_t v)
+   {
+#if defined(__GNUC__) || defined(__clang__)
+      return __builtin_ctzll(v);
+#else
+      size_t i = 0;
+      while( !(v & 1) ) { v >>= 1; ++i; }
+      return i;
+#endif
+   }
+
+   /// front places n before the timers already in its slot
+   void place(node* n, bool front = false)
+   {
+      const uint64_t delta = n->tick - current_tick_;
+      for( size_t level = 0; level < levels; ++level ) {
+         if( delta < (uint64_t(1) << (slot_bits * (level + 1))) ) {
+            const size_t slot = (n->tick >> (slot_bits * level)) & (slots - 1);
+            if( front )
+               wheel_[level][slot].push_front(n);
+            else
+               wheel_[level][slot].push_back(n);
+            set_bit(level, slot);
+            return;
+         }
+      }
+      if( front )
+         overflow_.push_front(n);
+      else
+         overflow_.push_back(n);
+   }
+
+   /// move the timers of the higher level slots that start at current_tick_ down
+   void cascade()
+   {
+      for( size_t level = 1; level < levels; ++level ) {
+         if( current_tick_ & ((uint64_t(1) << (slot_bits * level)) - 1) )
+            return;
+         const size_t slot = (current_tick_ >> (slot_bits * level)) & (slots - 1);
+         list l = wheel_[level][slot];
+         wheel_[level][slot] = list();
+         clear_bit(level, slot);
+         replace(l.head);
+         if( level == levels - 1 && slot == 0 ) {
+            list o = overflow_;
+            overflow_ = list();
+            replace(o.head);
+         }
+      }
+   }
+
+   /**
+    * Place the timers of a cascaded slot again. They were added while their deadline was further out than the
+    * slot they move to covers, so before any timer already there; they go in front, in their own order.
+    */
+   void replace(node* n)
+   {
+      node* reversed = nullptr;
+      while( n ) {
+         node* next = n->next;
+         n->next = reversed;
+         reversed = n;
+         n = next;
+      }
+      while( reversed ) {
+         node* next = reversed->next;
+         place(reversed, true);
+         reversed = next;
+      }
+   }
+
+   void recycle(node* n)
+   {
+      n->function = impl::handler_function(); // destroys what the handler captured
+      n->next = free_;
+      free_ = n;
+   }
+
+   void free_list(node* n)
+   {
+      while( n ) {
+         node* next = n->next;
+         recycle(n);
+         n = next;
+      }
+   }
+
+   void set_bit(size_t level, size_t slot)        { bits_[level][slot / 64] |= uint64_t(1) << (slot % 64); }
+   void clear_bit(size_t level, size_t slot)      { bits_[level][slot / 64] &= ~(uint64_t(1) << (slot % 64)); }
+
+   const clock::duration                                 tick_;
+   const clock::time_point                               start_;
+   uint64_t                                              current_tick_ = 0;
+   size_t                                                size_ = 0;
+   std::array<std::array<list, slots>, levels>           wheel_;
+   std::array<std::array<uint64_t, slots / 64>, levels>  bits_{}; // bit set if the slot is non-empty
+   list                                                  overflow_;
+   node*                                                 free_ = nullptr;
+};
+
+} // appbase
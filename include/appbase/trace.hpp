@@ -0,0 +1,276 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+namespace appbase {
+
+   namespace impl {
+      /**
+       * Fixed size ring of trace events written by a single thread. Readers on other threads copy the ring
+       * without locking and discard any event that was overwritten while they copied it.
+       */
+      class trace_buffer {
+         public:
+            struct event {
+               uint64_t    ts_ns;    ///< steady_clock time
+               uint64_t    id;       ///< links the enqueue, start and finish events of one handler
+               const char* tag;
+               int         priority;
+               char        phase;    ///< trace_recorder::enqueue, start or finish
+            };
+
+            trace_buffer(size_t capacity, uint32_t tid)
+            :_slots(new slot[capacity]), _mask(capacity - 1), _tid(tid)
+            {}
+
+            /// only called by the owning thread
+            void record(const event& e) {
+               const uint64_t k = _written.load(std::memory_order_relaxed);
+               _started.store(k + 1, std::memory_order_relaxed);
+               std::atomic_thread_fence(std::memory_order_release);
+               slot& s = _slots[k & _mask];
+               s.ts_ns.store(e.ts_ns, std::memory_order_relaxed);
+               s.id.store(e.id, std::memory_order_relaxed);
+               s.tag.store(e.tag, std::memory_order_relaxed);
+               s.priority.store(e.priority, std::memory_order_relaxed);
+               s.phase.store(e.phase, std::memory_order_relaxed);
+               _written.store(k + 1, std::memory_order_release);
+            }
+
+            /// the events currently in the ring, oldest first
+            std::vector<event> read() const {
+               const uint64_t capacity = _mask + 1;
+               const uint64_t end = _written.load(std::memory_order_acquire);
+               const uint64_t begin = end > capacity ? end - capacity : 0;
+               std::vector<event> events;
+               events.reserve(end - begin);
+               for( uint64_t p = begin; p < end; ++p ) {
+                  const slot& s = _slots[p & _mask];
+                  events.push_back(event{s.ts_ns.load(std::memory_order_relaxed), s.id.load(std::memory_order_relaxed),
+                                         s.tag.load(std::memory_order_relaxed), s.priority.load(std::memory_order_relaxed),
+                                         s.phase.load(std::memory_order_relaxed)});
+               }
+               std::atomic_thread_fence(std::memory_order_acquire);
+               // a write that started after the copy began may have overwritten the oldest events
+               const uint64_t started = _started.load(std::memory_order_relaxed);
+               const uint64_t valid = started > capacity ? started - capacity : 0;
+               if( valid > begin )
+                  events.erase(events.begin(), events.begin() + std::min<uint64_t>(valid - begin, events.size()));
+               return events;
+            }
+
+            uint32_t tid() const { return _tid; }
+
+            /// set by the owning thread after its last write
+            void set_exited() { _exited.store(true, std::memory_order_release); }
+            bool exited() const { return _exited.load(std::memory_order_acquire); }
+
+         private:
+            struct slot {
+               std::atomic<uint64_t>    ts_ns{0};
+               std::atomic<uint64_t>    id{0};
+               std::atomic<const char*> tag{nullptr};
+               std::atomic<int>         priority{0};
+               std::atomic<char>        phase{0};
+            };
+
+            std::unique_ptr<slot[]> _slots;
+            const uint64_t          _mask;
+            const uint32_t          _tid;
+            std::atomic<uint64_t>   _started{0}; ///< number of writes begun
+            std::atomic<uint64_t>   _written{0}; ///< number of writes completed
+            std::atomic<bool>       _exited{false};
+      };
+   }
+
+   /**
+    * Process wide recorder of handler enqueue, start and finish events. While enabled, every handler added to an
+    * execution_priority_queue records its events into a lock-free ring buffer of the recording thread, which keeps
+    * the latest buffer_events() events of each thread. write_chrome_trace() may be called from any thread at any time.
+    */
+   class trace_recorder {
+      public:
+         static constexpr char enqueue = 'q';
+         static constexpr char start   = 'B';
+         static constexpr char finish  = 'E';
+
+         static trace_recorder& instance() {
+            static trace_recorder recorder;
+            return recorder;
+         }
+
+         static bool enabled() { return enabled_flag().load(std::memory_order_relaxed); }
+
+         void set_enabled(bool enable) { enabled_flag().store(enable, std::memory_order_relaxed); }
+
+         /**
+          * Number of events kept per thread, rounded up to a power of 2.
+          * Only applies to threads that record their first event afterwards.
+          */
+         void set_buffer_events(size_t events) {
+            size_t capacity = 1;
+            while( capacity < events )
+               capacity <<= 1;
+            _buffer_events.store(capacity);
+         }
+
+         size_t buffer_events() const { return _buffer_events.load(); }
+
+         /**
+          * record an event on the calling thread
+          * @param id - the id returned by the enqueue event of the handler, ignored for enqueue
+          * @return the id of the event
+          */
+         uint64_t record(char phase, const char* tag, int priority, uint64_t id = 0) {
+            struct local_state {
+               std::shared_ptr<impl::trace_buffer> buffer;
+               uint64_t                            next_id = 0;
+
+               ~local_state() {
+                  if( buffer )
+                     buffer->set_exited();
+               }
+            };
+            static thread_local local_state local;
+            if( !local.buffer )
+               local.buffer = register_thread();
+            if( phase == enqueue )
+               id = (uint64_t(local.buffer->tid()) << 40) | ++local.next_id;
+            local.buffer->record(impl::trace_buffer::event{now_ns(), id, tag, priority, phase});
+            return id;
+         }
+
+         /**
+          * Write the recorded events of all threads in the Chrome trace event JSON format, which Perfetto
+          * and chrome://tracing load. Each handler is a slice named by its tag on the executing thread,
+          * with a flow from the instant it was enqueued on the posting thread.
+          * The buffers of threads that had exited before the call are released once written.
+          */
+         void write_chrome_trace(std::ostream& os) const {
+            std::vector<std::shared_ptr<impl::trace_buffer>> buffers;
+            {
+               std::lock_guard<std::mutex> g(_mtx);
+               buffers = _buffers;
+            }
+            // checked before reading, so that all events of an exited thread are in this trace
+            std::vector<const impl::trace_buffer*> exited;
+            for( const auto& buffer : buffers ) {
+               if( buffer->exited() )
+                  exited.push_back(buffer.get());
+            }
+#ifndef _WIN32
+            const long pid = ::getpid();
+#else
+            const long pid = 0;
+#endif
+            bool first = true;
+            auto write = [&](const char* ph, const impl::trace_buffer::event& e, uint32_t tid, const char* extra) {
+               char ts[32];
+               std::snprintf(ts, sizeof(ts), "%.3f", e.ts_ns / 1000.0);
+               os << (first ? "\n" : ",\n") << "{\"name\":\"";
+               write_escaped(os, e.tag ? e.tag : "handler");
+               os << "\",\"cat\":\"appbase\",\"ph\":\"" << ph << "\",\"pid\":" << pid << ",\"tid\":" << tid
+                  << ",\"ts\":" << ts << ",\"id\":" << e.id << extra << ",\"args\":{\"priority\":" << e.priority << "}}";
+               first = false;
+            };
+
+            os << "{\"traceEvents\":[";
+            for( const auto& buffer : buffers ) {
+               for( const auto& e : buffer->read() ) {
+                  if( e.phase == enqueue ) {
+                     write("i", e, buffer->tid(), ",\"s\":\"t\"");
+                     write("s", e, buffer->tid(), "");
+                  } else if( e.phase == start ) {
+                     write("B", e, buffer->tid(), "");
+                     write("f", e, buffer->tid(), ",\"bp\":\"e\"");
+                  } else {
+                     write("E", e, buffer->tid(), "");
+                  }
+               }
+            }
+            os << "\n],\"displayTimeUnit\":\"ns\"}\n";
+
+            if( !exited.empty() ) {
+               std::lock_guard<std::mutex> g(_mtx);
+               _buffers.erase(std::remove_if(_buffers.begin(), _buffers.end(), [&](const std::shared_ptr<impl::trace_buffer>& b) {
+                  return std::find(exited.begin(), exited.end(), b.get()) != exited.end();
+               }), _buffers.end());
+            }
+         }
+
+      private:
+         trace_recorder() = default;
+
+         static std::atomic<bool>& enabled_flag() {
+            static std::atomic<bool> flag{false};
+            return flag;
+         }
+
+         static uint64_t now_ns() {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+         }
+
+         static void write_escaped(std::ostream& os, const char* s) {
+            for( ; *s; ++s ) {
+               const unsigned char c = *s;
+               if( c == '"' || c == '\\' ) {
+                  os << '\\' << *s;
+               } else if( c < 0x20 ) {
+                  char buf[8];
+                  std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+                  os << buf;
+               } else {
+                  os << *s;
+               }
+            }
+         }
+
+         /// buffers are kept after their thread exits until write_chrome_trace() has written their events
+         std::shared_ptr<impl::trace_buffer> register_thread() {
+            std::lock_guard<std::mutex> g(_mtx);
+            _buffers.push_back(std::make_shared<impl::trace_buffer>(_buffer_events.load(), ++_next_tid));
+            return _buffers.back();
+         }
+
+         mutable std::mutex                                       _mtx;
+         mutable std::vector<std::shared_ptr<impl::trace_buffer>> _buffers;
+         uint32_t                                                 _next_tid = 0;
+         std::atomic<size_t>                              _buffer_events{16384};
+   };
+
+   namespace impl {
+      /**
+       * Handler wrapper recording the start and finish events of a handler, only used while tracing is enabled
+       */
+      template <typename F>
+      struct traced_handler {
+         F           function;
+         const char* tag;
+         int         priority;
+         uint64_t    id;
+
+         void operator()()
+         {
+            auto& recorder = trace_recorder::instance();
+            recorder.record(trace_recorder::start, tag, priority, id);
+            struct record_finish {
+               traced_handler& h;
+               ~record_finish() { trace_recorder::instance().record(trace_recorder::finish, h.tag, h.priority, h.id); }
+            } guard{*this};
+            function();
+         }
+      };
+   }
+
+}
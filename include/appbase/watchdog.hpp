@@ -0,0 +1,265 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__) && defined(__GLIBC__)
+#define APPBASE_WATCHDOG_STACK_SAMPLES 1
+#include <execinfo.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#endif
+
+namespace appbase {
+
+   /**
+    * A handler that ran past the watchdog budget
+    */
+   struct long_handler {
+      const char*              tag;       ///< posting site, nullptr if the handler was added without a tag
+      int                      priority;
+      std::chrono::nanoseconds running;   ///< how long the handler had been running when it was detected
+      std::thread::id          thread;
+   };
+
+   namespace impl {
+      /// what one executing thread is running, written by that thread and read by the watchdog
+      struct watch_slot {
+         std::atomic<uint64_t>    start_ns{0};     ///< 0 while not running a handler
+         std::atomic<uint64_t>    handler_seq{0};  ///< incremented per handler, detects a handler already reported
+         std::atomic<const char*> tag{nullptr};
+         std::atomic<int>         priority{0};
+         std::thread::id          thread = std::this_thread::get_id();
+         uint64_t                 reported_seq = 0; ///< only used by the watchdog thread
+#ifdef APPBASE_WATCHDOG_STACK_SAMPLES
+         pthread_t                native = pthread_self();
+#endif
+      };
+   }
+
+   /**
+    * Process wide watchdog that reports handlers executing for longer than a budget. While running, every handler
+    * added to an execution_priority_queue marks its start and finish on the executing thread; a watchdog thread
+    * checks those marks every quarter of the budget and reports each long handler once, while it is still running.
+    *
+    * On Linux with glibc the report can include a stack sample of the thread running the handler, taken by
+    * interrupting that thread with SIGURG.
+    */
+   class handler_watchdog {
+      public:
+         using report_function = std::function<void(const long_handler&)>;
+
+         static handler_watchdog& instance() {
+            static handler_watchdog watchdog;
+            return watchdog;
+         }
+
+         ~handler_watchdog() { stop(); }
+
+         static bool enabled() { return enabled_flag().load(std::memory_order_relaxed); }
+
+         /**
+          * start watching handlers
+          * @param budget - handlers running longer are reported
+          * @param stack_samples - also write the stack of the thread running the handler to std::cerr, if supported
+          */
+         void start(std::chrono::microseconds budget, bool stack_samples) {
+            stop();
+            _budget = std::max(budget, std::chrono::microseconds(1));
+            _stack_samples = stack_samples;
+#ifdef APPBASE_WATCHDOG_STACK_SAMPLES
+            if( _stack_samples )
+               install_sample_handler();
+#endif
+            _stopping = false;
+            enabled_flag().store(true, std::memory_order_relaxed);
+            _thread = std::thread([this]() { run(); });
+         }
+
+         void stop() {
+            if( !_thread.joinable() )
+               return;
+            enabled_flag().store(false, std::memory_order_relaxed);
+            {
+               std::lock_guard<std::mutex> g(_mtx);
+               _stopping = true;
+            }
+            _cv.notify_all();
+            _thread.join();
+         }
+
+         /**
+          * Replace the default report, which writes the handler to std::cerr. Called on the watchdog thread;
+          * set before start().
+          */
+         void set_report(report_function report) { _report = std::move(report); }
+
+         /// number of long handlers reported since the process started
+         uint64_t reports() const { return _reports.load(); }
+
+         /// slot of the calling thread, registered on first use
+         impl::watch_slot& local_slot() {
+            static thread_local std::shared_ptr<impl::watch_slot> slot;
+            if( !slot ) {
+               slot = std::make_shared<impl::watch_slot>();
+               std::lock_guard<std::mutex> g(_mtx);
+               _slots.push_back(slot);
+            }
+            return *slot;
+         }
+
+         static uint64_t now_ns() {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+         }
+
+      private:
+         handler_watchdog() = default;
+
+         static std::atomic<bool>& enabled_flag() {
+            static std::atomic<bool> flag{false};
+            return flag;
+         }
+
+         void run() {
+            const auto interval = std::max<std::chrono::microseconds>(_budget / 4, std::chrono::milliseconds(1));
+            std::vector<std::shared_ptr<impl::watch_slot>> slots;
+            std::unique_lock<std::mutex> g(_mtx);
+            while( !_cv.wait_for(g, interval, [this]() { return _stopping; }) ) {
+               // slots of exited threads are idle forever, drop them
+               _slots.erase(std::remove_if(_slots.begin(), _slots.end(), [](const auto& s) { return s.use_count() == 1; }), _slots.end());
+               slots = _slots;
+               g.unlock();
+               for( const auto& slot : slots )
+                  check(*slot);
+               slots.clear();
+               g.lock();
+            }
+         }
+
+         void check(impl::watch_slot& slot) {
+            const uint64_t start = slot.start_ns.load(std::memory_order_acquire);
+            const uint64_t seq = slot.handler_seq.load(std::memory_order_relaxed);
+            const char* tag = slot.tag.load(std::memory_order_relaxed);
+            const int priority = slot.priority.load(std::memory_order_relaxed);
+            const uint64_t now = now_ns();
+            // the handler finished or another one started while reading, check again next time
+            if( !start || slot.start_ns.load(std::memory_order_acquire) != start )
+               return;
+            if( now <= start || std::chrono::nanoseconds(now - start) < _budget || slot.reported_seq == seq )
+               return;
+            slot.reported_seq = seq;
+            long_handler h{tag, priority, std::chrono::nanoseconds(now - start), slot.thread};
+            ++_reports;
+            if( _report )
+               _report(h);
+            else
+               print(h);
+#ifdef APPBASE_WATCHDOG_STACK_SAMPLES
+            if( _stack_samples )
+               sample_stack(slot.native);
+#endif
+         }
+
+         static void print(const long_handler& h) {
+            std::cerr << "APPBASE: watchdog: handler " << (h.tag ? h.tag : "(untagged)") << " priority " << h.priority
+                      << " has been running for " << std::chrono::duration_cast<std::chrono::milliseconds>(h.running).count()
+                      << " ms on thread " << h.thread << std::endl;
+         }
+
+#ifdef APPBASE_WATCHDOG_STACK_SAMPLES
+         static constexpr int max_frames = 64;
+
+         struct stack_sample {
+            void*            frames[max_frames];
+            std::atomic<int> depth{-1};
+         };
+
+         static stack_sample& sample() {
+            static stack_sample s;
+            return s;
+         }
+
+         static void on_sample_signal(int) {
+            stack_sample& s = sample();
+            s.depth.store(::backtrace(s.frames, max_frames), std::memory_order_release);
+         }
+
+         static void install_sample_handler() {
+            // the first backtrace() loads libgcc, which must not happen inside the signal handler
+            ::backtrace(sample().frames, 1);
+            struct sigaction sa{};
+            sa.sa_handler = &on_sample_signal;
+            sigemptyset(&sa.sa_mask);
+            sa.sa_flags = SA_RESTART;
+            ::sigaction(SIGURG, &sa, nullptr);
+         }
+
+         static void sample_stack(pthread_t thread) {
+            stack_sample& s = sample();
+            s.depth.store(-1, std::memory_order_relaxed);
+            if( ::pthread_kill(thread, SIGURG) != 0 )
+               return;
+            const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(100);
+            int depth = -1;
+            while( (depth = s.depth.load(std::memory_order_acquire)) < 0 && std::chrono::steady_clock::now() < deadline )
+               std::this_thread::sleep_for(std::chrono::microseconds(100));
+            if( depth <= 0 )
+               return;
+            std::cerr << "APPBASE: watchdog: stack sample" << std::endl;
+            ::backtrace_symbols_fd(s.frames, depth, STDERR_FILENO);
+         }
+#endif
+
+         std::chrono::microseconds                     _budget{0};
+         bool                                          _stack_samples = false;
+         report_function                               _report;
+         std::atomic<uint64_t>                         _reports{0};
+
+         std::mutex                                    _mtx;
+         std::condition_variable                       _cv;
+         bool                                          _stopping = false;
+         std::thread                                   _thread;
+         std::vector<std::shared_ptr<impl::watch_slot>> _slots;
+   };
+
+   namespace impl {
+      /**
+       * Handler wrapper marking the start and finish of a handler for the watchdog, only used while it runs
+       */
+      template <typename F>
+      struct watched_handler {
+         F           function;
+         const char* tag;
+         int         priority;
+
+         void operator()()
+         {
+            watch_slot& slot = handler_watchdog::instance().local_slot();
+            // a handler run from inside another handler is watched as part of the outer one
+            if( slot.start_ns.load(std::memory_order_relaxed) ) {
+               function();
+               return;
+            }
+            slot.tag.store(tag, std::memory_order_relaxed);
+            slot.priority.store(priority, std::memory_order_relaxed);
+            slot.handler_seq.fetch_add(1, std::memory_order_relaxed);
+            slot.start_ns.store(handler_watchdog::now_ns(), std::memory_order_release);
+            struct mark_finish {
+               watch_slot& slot;
+               ~mark_finish() { slot.start_ns.store(0, std::memory_order_release); }
+            } guard{slot};
+            function();
+         }
+      };
+   }
+
+}